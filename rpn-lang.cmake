@@ -1,6 +1,6 @@
 
 set(RPN_LANG_DIR ${CMAKE_CURRENT_LIST_DIR})
-set(RPN_LANG_SRCS rpn-stack.cpp rpn-interp.cpp types-dict.cpp math-dict.cpp stack-dict.cpp logic-dict.cpp keypad-dict.cpp)
+set(RPN_LANG_SRCS rpn-stack.cpp rpn-interp.cpp types-dict.cpp math-dict.cpp stack-dict.cpp logic-dict.cpp keypad-dict.cpp shunting-yard.cpp rpn-jit.cpp rpn-binary.cpp rpn-output.cpp)
 
 list(TRANSFORM RPN_LANG_SRCS PREPEND ${RPN_LANG_DIR}/src/)
 
@@ -14,23 +14,83 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
-#include <deque>
+#include <string_view>
 #include <map>
 #include <cmath>
 #include <stdexcept>
 #include <functional>
+#include <future>
+#include <iosfwd>
+#include <tuple>
+#include <typeinfo>
+#include <type_traits>
+#include <utility>
 
 namespace rpn {
   std::string to_string(const double &dv);
 
+  // algebraic (infix) expression to rpn words, 'assign' is set for "name = expr"
+  bool infix_to_rpn(const std::string &expr, std::vector<std::string> &words, std::string &assign, std::string &err);
+
+  using TypeId = uint16_t;
+
+  /*
+   * Registry of the Stack::Object types.  Each type gets a small dense
+   * id when it is first seen (or registered by name), the built-ins have
+   * the fixed ones below.  Objects remember their id, so a type test is
+   * an integer compare for host types as well as for the built-ins.
+   */
+  class Types {
+  public:
+    static constexpr TypeId none = 0; // past the bottom of the stack
+    static constexpr TypeId any = 1;  // Stack::Object, matches every type in validators
+    static constexpr TypeId t_double = 2;
+    static constexpr TypeId t_integer = 3;
+    static constexpr TypeId t_boolean = 4;
+    static constexpr TypeId t_string = 5;
+    static constexpr TypeId t_object = 6;
+    static constexpr TypeId t_array = 7;
+    static constexpr TypeId t_vec3 = 8;
+
+    static TypeId id(const std::type_info &type);
+    static TypeId add(const std::type_info &type, const std::string &name); // names it, returns the id
+    static std::string name(TypeId id);
+
+    template<typename T> static TypeId of() {
+      static const TypeId rv = id(typeid(T));
+      return rv;
+    }
+    template<typename T> static TypeId add(const std::string &name) { return add(typeid(T), name); }
+  };
+
   class Stack {
   public:
     class Object {
     public:
+      Object() = default;
+      Object(const Object &o) : _type(o._type.load(std::memory_order_relaxed)) {}
+      Object &operator=(const Object &o) { _type.store(o._type.load(std::memory_order_relaxed), std::memory_order_relaxed); return *this; }
       virtual ~Object() {};
+      // set at construction by TStackObject and StVec3, looked up on first
+      // use for the types that don't pass one
+      TypeId type_id() const {
+	TypeId rv = _type.load(std::memory_order_relaxed);
+	if (rv == Types::none) {
+	  rv = Types::id(typeid(*this));
+	  _type.store(rv, std::memory_order_relaxed);
+	}
+	return rv;
+      }
       virtual bool operator==(const Object &rhs) const =0;
       virtual bool operator>(const Object &/*rhs*/) const {
         throw std::runtime_error("operator> invalid for type");
@@ -40,13 +100,35 @@ namespace rpn {
       };
       virtual operator std::string() const =0;
       virtual std::unique_ptr<Object> deep_copy() const =0;
+      virtual size_t footprint() const { return sizeof(Object); } // bytes, roughly, with what it owns
       std::string to_string() const { return static_cast<std::string>(*this); }
+    protected:
+      explicit Object(TypeId type) : _type(type) {} // the id of the most derived type
+    private:
+      mutable std::atomic<TypeId> _type {Types::none};
+    };
+
+    /*
+     * Immutable, published view of the stack.  The interpreter thread
+     * publishes a new one after each request; any thread may read the
+     * current one without touching the live stack.
+     */
+    struct Snapshot {
+      uint64_t version;
+      std::vector<std::string> items;  // string form, bottom (0) to top
+      std::vector<uint64_t> changed;   // version each item last changed in
+      std::string status;              // the interpreter's status as of this version
+
+      // lowest index that changed after version 'since' (items.size() if none)
+      size_t dirty_from(uint64_t since) const;
     };
+    using Observer = std::function<void(const std::shared_ptr<const Snapshot> &)>;
 
-    Stack() {};
+    Stack();
     ~Stack() {};
 
     void push(const Object &ob);
+    void push(std::unique_ptr<Object> ob);
     void push_boolean(const bool &val);
     void push_string(const std::string &val);
     void push_integer(const int64_t &val);
@@ -61,7 +143,17 @@ namespace rpn {
 
     std::unique_ptr<Object> pop();
 
+    // peek is for inspection; modify by pop/push so that observers see it
     Object &peek(int n);
+    // marks the top n slots changed and hands the nth to f to change in
+    // place; its footprint is counted again after
+    template<typename F> void modify(int n, F f) {
+      Object &ob = poke(n);
+      size_t was = ob.footprint();
+      f(ob);
+      add_bytes(ob.footprint());
+      sub_bytes(was);
+    }
     bool peek_boolean(int n);
     std::string peek_string(int n);
     std::string peek_as_string(int n); // auto-converts to string if the type is not string
@@ -71,6 +163,7 @@ namespace rpn {
 
     // basic stack operations
 
+    void reserve(size_t n); // preallocate for n slots
     void clear(); // [prim]
     size_t depth(); // [prim]
     void dropn(int n); // [prim]
@@ -95,9 +188,67 @@ namespace rpn {
 
     void print(const std::string &msg="");
 
-    std::vector<size_t> types() const;
+    std::vector<TypeId> types() const; // [0] is tos
+    TypeId type(int n) const; // of peek(n), Types::none past the bottom
+
+    // snapshot publication, see Snapshot above
+    uint64_t publish(const std::string &status=""); // owning thread only, returns the published version
+    std::shared_ptr<const Snapshot> snapshot() const; // any thread
+    void observe(const Observer &observer); // called from publish()
+
+    // undo history, the interpreter checkpoints after each request
+    void checkpoint(); // records a new state if the stack changed since the last one
+    bool undo(); // back to the previous state, false if there is none
+    bool redo(); // forward again after undo, until the stack is changed
+    size_t undo_levels() const;
+    size_t redo_levels() const;
+    void history_limit(size_t n); // states kept, default 4096
+    bool trim_history(); // drops the redo states, or else the oldest one; false if only the current is left
+
+    // binary encoding of the whole stack, see StackWriter below
+    void save(std::ostream &os) const;
+    void load(std::istream &is); // replaces the contents, unchanged if it throws
+
+    // footprints of the items and of the undo history's copies, any thread
+    size_t bytes() const { return _bytes.load(std::memory_order_relaxed); }
+    size_t history_bytes() const { return _historyBytes.load(std::memory_order_relaxed); }
+    void rollback(); // back to the last checkpoint, dropping the changes since
+
   private:
-    std::deque<std::unique_ptr<Object>> _stack;
+    void touch(size_t n); // top n slots were modified
+    Object &poke(int n); // peek for writing in place, see modify()
+
+    /*
+     * A history state keeps copies of the slots that changed since the
+     * state before it; the slots under 'base' are the same as in that
+     * state, so they are shared rather than copied.  The oldest state
+     * always has base 0.
+     */
+    struct State {
+      size_t depth;
+      size_t base;
+      std::vector<std::unique_ptr<const Object>> slots; // [base, depth)
+      size_t bytes = 0; // of the slots
+    };
+    const Object &state_item(size_t state, size_t i) const;
+    void drop_oldest(); // folds _history[0] into _history[1]
+    void restore(size_t state, size_t from); // slots [from, depth) of a state onto the stack
+
+    std::vector<std::unique_ptr<Object>> _stack; // top of stack is at the end
+    std::shared_ptr<const Snapshot> _published;
+    size_t _dirty; // lowest (bottom-relative) index modified since publish()
+    Observer _observer;
+
+    std::deque<State> _history;
+    size_t _current;    // the state the stack was in at the last checkpoint
+    size_t _changed;    // lowest index modified since the last checkpoint, -1 if none
+    size_t _historyLimit;
+
+    // owner thread writes, others only read
+    std::atomic<size_t> _bytes {0};
+    std::atomic<size_t> _historyBytes {0};
+    void add_bytes(size_t n) { _bytes.store(bytes() + n, std::memory_order_relaxed); }
+    void sub_bytes(size_t n) { _bytes.store(bytes() - n, std::memory_order_relaxed); }
   };
 
   class Interp;
@@ -110,10 +261,145 @@ namespace rpn {
   protected:
   };
 
+  /*
+   * Versioned binary encoding of stack objects.  A stream is an 8 byte
+   * header ("RPNS", version, flags) followed by tagged objects and an
+   * end tag; the tags are the fixed rpn::Types ids of the built-ins.
+   * Numbers are stored exactly, little endian.  Objects of application
+   * types have no encoding and throw std::runtime_error, as do bad or
+   * truncated streams on read.
+   */
+  class StackWriter {
+  public:
+    static constexpr uint16_t version = 1;
+
+    explicit StackWriter(std::ostream &os); // writes the header
+    ~StackWriter(); // close()
+    void write(const Stack::Object &ob);
+    void close(); // writes the end tag and flushes, once; not after a write threw
+  private:
+    void encode(const Stack::Object &ob);
+    void flush();
+    void put(const void *p, size_t n);
+    void put_u8(uint8_t v);
+    void put_u64(uint64_t v);
+    void put_size(size_t v);
+    void put_string(const std::string &s);
+
+    std::ostream &_os;
+    std::string _buf;
+    bool _closed = false;
+    bool _failed = false;
+  };
+
+  class StackReader {
+  public:
+    explicit StackReader(std::istream &is); // reads and checks the header
+    std::unique_ptr<Stack::Object> read(); // nullptr after the last object
+    uint16_t version() const { return _version; }
+  private:
+    std::unique_ptr<Stack::Object> read(uint8_t tag);
+    void fill(size_t n); // at least n bytes buffered or throws
+    void get(void *p, size_t n);
+    uint8_t get_u8();
+    uint64_t get_u64();
+    size_t get_size();
+    std::string get_string();
+
+    std::istream &_is;
+    std::vector<char> _buf;
+    size_t _pos = 0;
+    uint16_t _version = 0;
+    bool _end = false;
+  };
+
+  /*
+   * Records (lines, usually) from the interpreter to the host, see
+   * Interp::output().  One writer, one reader: the writer copies each
+   * record into a fixed ring behind a small length header and waits
+   * for room when it is full; the reader takes everything written so
+   * far in one batch of views into the ring, and the space goes back to
+   * the writer when the batch is done.  Neither side locks unless it has
+   * to wait.
+   */
+  class OutputChannel {
+  public:
+    explicit OutputChannel(size_t capacity = 64 * 1024);
+    size_t capacity() const { return _ring.size(); }
+    size_t max_record() const { return _ring.size() / 2 - header; }
+
+    // writer: false when there isn't room yet, or ever (> max_record())
+    bool try_write(std::string_view rec);
+    bool wait_room(size_t n, std::chrono::milliseconds timeout); // true when there is
+
+    // reader: the records not yet taken, oldest first, at most 'max' of
+    // them; the views are good until the handler returns
+    using Batch = std::vector<std::string_view>;
+    size_t drain(const std::function<void(const Batch &)> &handler, size_t max = SIZE_MAX);
+    bool wait_data(std::chrono::milliseconds timeout); // true when there is
+    void wake(); // the waiting reader or writer, to look again
+
+    struct Stats {
+      uint64_t records = 0; // written
+      uint64_t bytes = 0;   // of them
+      uint64_t batches = 0; // drained
+      uint64_t full = 0;    // writes that found no room
+      size_t high_water = 0; // most of the ring in use
+    };
+    Stats stats() const;
+
+  private:
+    static constexpr size_t header = sizeof(uint32_t);
+    static constexpr uint32_t wrap = UINT32_MAX; // rest of the ring unused
+    size_t used() const { return _head.load() - _tail.load(); }
+
+    std::vector<char> _ring;
+    std::atomic<size_t> _head {0}; // bytes ever written, _ring[_head % capacity] is next
+    std::atomic<size_t> _tail {0}; // bytes ever released
+    std::atomic<bool> _readerWaits {false};
+    std::atomic<bool> _writerWaits {false};
+    std::mutex _mx; // only to wait
+    std::condition_variable _cv;
+    uint64_t _wakes = 0; // under _mx
+    Batch _batch; // reader's
+    std::atomic<uint64_t> _records {0};
+    std::atomic<uint64_t> _bytes {0};
+    std::atomic<uint64_t> _batches {0};
+    std::atomic<uint64_t> _full {0};
+    std::atomic<size_t> _highWater {0};
+  };
+
+  // where Interp::outputSink() sends the batches, on a thread of its own
+  class OutputSink {
+  public:
+    virtual ~OutputSink() {}
+    virtual void write(const OutputChannel::Batch &records) =0;
+  };
+
+  // stand-in for a host, for tests and benchmarks: keeps copies
+  class MemorySink : public OutputSink {
+  public:
+    void write(const OutputChannel::Batch &records) override;
+    std::vector<std::string> records();
+    uint64_t batches();
+    bool wait_for(size_t n, std::chrono::milliseconds timeout); // true when it has n records
+  private:
+    std::mutex _mx;
+    std::condition_variable _cv;
+    std::vector<std::string> _records;
+    uint64_t _batches = 0;
+  };
+
   // Class family for validating word definitions against stack type and depth
   class StackValidator {
   public:
-    virtual bool operator()(const std::vector<size_t> &types, rpn::Stack &stack) const =0;
+    virtual bool operator()(rpn::Stack &stack) const =0;
+
+    // compile-time version of operator(): 'known' are the types proven to be
+    // on top of the stack ([0] is tos), 'tos' the value of a known integer on
+    // top.  deeper means it can't tell without knowing more of the stack.
+    enum class Proof { accept, reject, unknown, deeper };
+    virtual Proof prove(const std::vector<TypeId> &known, const int64_t *tos) const { return Proof::unknown; }
   protected:
   };
 
@@ -144,6 +430,8 @@ namespace rpn {
 
     static const StrictTypeValidator d2_string_any;
     static const StrictTypeValidator d2_any_string;
+    static const StrictTypeValidator d2_string_array;
+    static const StrictTypeValidator d2_string_string;
 
     static const StrictTypeValidator d2_object_any;
     static const StrictTypeValidator d2_any_object;
@@ -161,17 +449,21 @@ namespace rpn {
     static const StrictTypeValidator d3_any_any_boolean;
     static const StrictTypeValidator d3_object_string_any;
     static const StrictTypeValidator d3_string_any_object;
+    static const StrictTypeValidator d3_string_any_array;
 
     static const StrictTypeValidator d4_double_double_double_integer;
     static const StrictTypeValidator d4_integer_double_double_double;
 
-    static const size_t v_anytype;
+    static constexpr TypeId v_anytype = Types::any;
     //    static const size_t v_numbertype;  // is harder than it sounds...
+    static constexpr size_t max_types = 8;
 
-    StrictTypeValidator(const std::vector<size_t> &types) : _types(types) {}
-    virtual bool operator()(const std::vector<size_t> &types, rpn::Stack &stack) const override;
+    StrictTypeValidator(const std::vector<TypeId> &types); // [0] is tos
+    virtual bool operator()(rpn::Stack &stack) const override;
+    virtual Proof prove(const std::vector<TypeId> &known, const int64_t *tos) const override;
   private:
-    const std::vector<size_t> _types;
+    size_t _n;
+    std::array<TypeId, max_types> _types;
   };
 
   class StackSizeValidator : public StackValidator {
@@ -183,7 +475,8 @@ namespace rpn {
     static const StackSizeValidator ntos; // n top of stack
     
     StackSizeValidator(size_t n) : _n(n) {}
-    virtual bool operator()(const std::vector<size_t> &types, rpn::Stack &stack) const override;
+    virtual bool operator()(rpn::Stack &stack) const override;
+    virtual Proof prove(const std::vector<TypeId> &known, const int64_t *tos) const override;
   private:
     size_t _n;
   };
@@ -197,11 +490,20 @@ namespace rpn {
       eval_error, // eval went awry
       compile_error, // error in compiling
       implementation_error, // not implmemented or similar
+      cancelled, // stopped by Interp::cancel() or its Interp::Budget
+      memory_error, // out of memory, or over Interp::memoryLimits()
     };
+    using Native = Result (*)(Interp &rpn, WordContext *ctx, std::string &rest);
+
     //    std::string description;
     const StackValidator &validator;
     std::function<Result(Interp &rpn, WordContext *ctx, std::string &rest)> eval;
     WordContext *context;
+    Native native = nullptr; // same as eval, called directly when set (see rpn::bind)
+
+    Result invoke(Interp &rpn, std::string &rest) const {
+      return (native) ? native(rpn, context, rest) : eval(rpn, context, rest);
+    }
   };
 
   class Interp {
@@ -211,8 +513,95 @@ namespace rpn {
     static void nullCompletionHandler(rpn::WordDefinition::Result) {};
 
     rpn::WordDefinition::Result sync_eval(std::string line);
-    void eval(std::string line, std::function<void(rpn::WordDefinition::Result)>completionHandler=nullCompletionHandler);
-    void parseFile(const std::string &path, std::function<void(rpn::WordDefinition::Result)>completionHandler=nullCompletionHandler);
+
+    // queued requests run interactive first; a bulk one gets its turn after
+    // a few interactive ones in a row, and a bulk file yields between lines
+    enum class Priority { interactive, bulk };
+    void eval(std::string line, std::function<void(rpn::WordDefinition::Result)>completionHandler=nullCompletionHandler, Priority prio=Priority::interactive);
+
+    // queued like eval(), the future is ready when the request has run;
+    // outputs are copies of the top 'capture' stack items then, [0] is tos
+    struct Reply {
+      rpn::WordDefinition::Result result;
+      std::vector<std::unique_ptr<Stack::Object>> outputs;
+    };
+    std::future<Reply> submit(std::string line, size_t capture=0, Priority prio=Priority::interactive);
+    std::vector<std::future<Reply>> submit(const std::vector<std::string> &lines, size_t capture=0, Priority prio=Priority::interactive); // queued in one go
+    void parseFile(const std::string &path, std::function<void(rpn::WordDefinition::Result)>completionHandler=nullCompletionHandler, Priority prio=Priority::bulk);
+    // compiles the definitions changed since the file was parsed (and the
+    // words using them when next run), forgets the ones taken out; the
+    // rest of the file isn't run again
+    void reloadFile(const std::string &path, std::function<void(rpn::WordDefinition::Result)>completionHandler=nullCompletionHandler, Priority prio=Priority::bulk);
+
+    // completed requests of a lane, times from when they were queued to
+    // when they started (wait) and finished (latency); totals and worst
+    struct LaneStats {
+      uint64_t requests = 0;
+      std::chrono::microseconds wait {0};
+      std::chrono::microseconds wait_max {0};
+      std::chrono::microseconds latency {0};
+      std::chrono::microseconds latency_max {0};
+    };
+    LaneStats laneStats(Priority lane);
+
+    // MAP, PARREDUCE and PARFOR runs that were split across cores
+    struct ParallelStats {
+      uint64_t map = 0;
+      uint64_t reduce = 0;
+      uint64_t parfor = 0;
+    };
+    ParallelStats parallelStats();
+
+    // a compiled body is released when neither the dictionary nor a
+    // running word holds it, so words and progns stay flat while words
+    // are redefined; the sizes are footprints, roughly, in bytes
+    struct MemoryStats {
+      size_t words = 0;  // compiled words in the dictionary
+      size_t progns = 0; // bodies alive: those words, their loops, EVAL expressions, top level constructs running
+      size_t code = 0;      // those bodies' compiled source
+      size_t stack = 0;     // the items
+      size_t history = 0;   // the undo history's copies of items
+      size_t variables = 0; // STO and EVAL assignments
+      size_t total = 0;
+      size_t peak = 0;      // highest total seen after a request or a limit check
+      bool over_soft = false; // the total was over the soft limit when last checked
+    };
+    MemoryStats memoryStats();
+    // past 'soft' MemoryStats::over_soft is set (and traced); a word that
+    // adds to the total past 'hard', even after undo history is dropped,
+    // fails with Result::memory_error and its request's changes to the
+    // stack are rolled back; 0 is no limit
+    struct MemoryLimits {
+      size_t soft = 0;
+      size_t hard = 0;
+    };
+    void memoryLimits(const MemoryLimits &limits);
+    // binary stack files, see Stack::save()
+    void saveStack(const std::string &path, std::function<void(rpn::WordDefinition::Result)>completionHandler=nullCompletionHandler);
+    void restoreStack(const std::string &path, std::function<void(rpn::WordDefinition::Result)>completionHandler=nullCompletionHandler);
+    // step the stack back/forward one request, see Stack::undo()
+    void undo(std::function<void(rpn::WordDefinition::Result)>completionHandler=nullCompletionHandler);
+    void redo(std::function<void(rpn::WordDefinition::Result)>completionHandler=nullCompletionHandler);
+
+    // limits on one queued request, 0 is none; past either one, or after
+    // cancel(), the request stops with Result::cancelled
+    struct Budget {
+      uint64_t words = 0; // words run
+      std::chrono::milliseconds time {0}; // running time
+    };
+    void budget(const Budget &b); // for the requests queued from now on
+    void cancel(); // the running request, if any
+    // a file runs this long before it lets queued requests in, between
+    // lines and never inside a definition; 0 runs files to completion
+    void quantum(std::chrono::milliseconds q);
+
+    // SEND ( string -- ) writes a record here for the host to drain,
+    // waiting while the channel is full (or until the request is
+    // cancelled or out of time, leaving the record on the stack); with a
+    // sink set, a thread drains it there and the destructor hands it the
+    // rest, nullptr stops that and leaves the rest for drain()
+    OutputChannel &output();
+    void outputSink(std::shared_ptr<OutputSink> sink);
 
     bool addDefinition(const std::string &word, const WordDefinition &def);
     bool removeDefinition(const std::string &word);
@@ -230,7 +619,7 @@ namespace rpn {
      */
 
     Stack stack;
-    const std::string &status();
+    const std::string &status(); // interpreter thread, others read stack.snapshot()->status
 
     struct Privates;
   private:
@@ -261,11 +650,16 @@ namespace rpn {
 #define POP_CAST(obtype,ob)  dynamic_cast<obtype&>(*ob.get())
 #define OBJECTP_CAST(obtype)  dynamic_cast<obtype*>
 
+// what a value holds outside itself, see Stack::Object::footprint(); the
+// types with storage of their own overload it
+template<typename T>
+size_t heap_bytes(const T &) { return 0; }
+
 template<typename T>
 class TStackObject : public rpn::Stack::Object {
  public:
-  TStackObject() = default; //: _v(v) {}
-  TStackObject(const T &v) : _v(v) {}
+  TStackObject() : Object(rpn::Types::of<TStackObject<T>>()) {}
+  TStackObject(const T &v) : Object(rpn::Types::of<TStackObject<T>>()), _v(v) {}
   virtual bool operator==(const Object &orhs) const override {
     auto *rhs = OBJECTP_CAST(const TStackObject<T>)(&orhs);
     return (rhs !=nullptr && _v == rhs->_v);
@@ -280,9 +674,11 @@ class TStackObject : public rpn::Stack::Object {
   }
   virtual ~TStackObject() {}
   virtual std::unique_ptr<rpn::Stack::Object> deep_copy() const override { return std::make_unique<TStackObject<T>>(*this); };
+  virtual size_t footprint() const override { return sizeof(*this) + heap_bytes(_v); }
   virtual operator std::string() const override { return (std::string)_v; };
   auto val() const { return _v; };
   auto &inner() { return _v; };
+  const auto &inner() const { return _v; };
  private:
   T _v;
 };
@@ -303,7 +699,7 @@ class XInteger {
  public:
  XInteger(const int64_t &v) : _v(v) {}
   virtual operator std::string() const { return std::to_string(_v); };
-  operator uint64_t() const { return _v; };
+  operator int64_t() const { return _v; };
   bool operator==(const XInteger &rhs) const {
     return _v == rhs._v;
   }
@@ -337,6 +733,9 @@ class XString {
   bool operator<(const XString &rhs) const {
     return _v < rhs._v;
   }
+  // in place, so repeated appends grow geometrically instead of copying
+  void append(const XString &x) { _v += x._v; }
+  friend size_t heap_bytes(const XString &x) { return (x._v.capacity() > 15) ? x._v.capacity()+1 : 0; }
  private:
   std::string _v;
 };
@@ -368,6 +767,9 @@ public:
   void add_value(const std::string &name, const rpn::Stack::Object &val) {
     _v.emplace(name, val.deep_copy());
   }
+  void add_value(const std::string &name, std::unique_ptr<rpn::Stack::Object> val) {
+    _v.emplace(name, std::move(val));
+  }
   bool has_member(const std::string &name) {
     return (_v.find(name) != _v.end());
   }
@@ -392,6 +794,13 @@ public:
     return rv;
   };
   const auto &val() const { return _v; };
+  friend size_t heap_bytes(const XObject &x) {
+    size_t rv = 0;
+    for(auto const &m : x._v) {
+      rv += 48 + sizeof(m) + ((m.first.capacity() > 15) ? m.first.capacity()+1 : 0) + m.second->footprint(); // 48: tree node
+    }
+    return rv;
+  }
 protected:
   std::map<std::string,std::unique_ptr<rpn::Stack::Object>> _v;
 };
@@ -407,7 +816,7 @@ public:
   bool operator==(const XArray &rhs) const {
     bool rv = _v.size() == rhs._v.size();
     for(auto i=_v.cbegin(), j=rhs._v.cbegin(); rv && i!= _v.cend(); i++,j++) {
-      rv &= (*i == *j);
+      rv &= (**i == **j);
     }
     return rv;
   }
@@ -422,6 +831,9 @@ public:
   void add_value(const rpn::Stack::Object &val) {
     _v.push_back(val.deep_copy());
   }
+  void add_value(std::unique_ptr<rpn::Stack::Object> val) {
+    _v.push_back(std::move(val));
+  }
   virtual operator std::string() const {
     std::string rv = "[";
     for(auto const &e : _v) {
@@ -432,6 +844,13 @@ public:
     return rv;
   };
   const auto &val() const { return _v; };
+  friend size_t heap_bytes(const XArray &x) {
+    size_t rv = x._v.capacity() * sizeof(x._v[0]);
+    for(auto const &e : x._v) {
+      rv += e->footprint();
+    }
+    return rv;
+  }
  protected:
   std::vector<std::unique_ptr<rpn::Stack::Object>> _v;
 };
@@ -445,8 +864,8 @@ using StArray = TStackObject<XArray>;
 
 class StVec3 : public rpn::Stack::Object {
 public:
-  StVec3(const StVec3 &other) : _x(other._x), _y(other._y), _z(other._z) {};
-  StVec3(const double &x=std::nan(""), const double &y=std::nan(""), const double &z=std::nan("")) : _x(x), _y(y), _z(z) {};
+  StVec3(const StVec3 &other) : Object(other), _x(other._x), _y(other._y), _z(other._z) {};
+  StVec3(const double &x=std::nan(""), const double &y=std::nan(""), const double &z=std::nan("")) : Object(rpn::Types::t_vec3), _x(x), _y(y), _z(z) {};
   virtual ~StVec3() {};
   virtual bool operator==(const Object &orhs) const override {
     const StVec3 &rhs = PEEK_CAST(const StVec3,orhs);
@@ -474,6 +893,7 @@ public:
     return rv;
   }
   virtual std::unique_ptr<Object> deep_copy() const override { return std::make_unique<StVec3>(*this); }
+  virtual size_t footprint() const override { return sizeof(*this); }
 
 public:
   // should these be public or private?
@@ -547,4 +967,144 @@ public:
   r.addDefinition(symbol, NATIVE_WORD_WDEF(mangler, rpn::StrictTypeValidator::d1_integer, integer_func, ptr))
 
 
+/*
+ * Native words bound from their C++ signature.  The validator, the
+ * argument extraction and the result push are generated at compile
+ * time, the last parameter is the top of stack:
+ *
+ *   static double hypot3(double x, double y, double z) { ... }
+ *   rpn::bind::add<hypot3>(rpn, "HYPOT3");                // d3_double_double_double
+ *   rpn::bind::add_number<hypot3, hypot3>(rpn, "HYPOT3"); // all 8 double/integer mixes
+ *
+ * Parameters are double, int64_t, bool, std::string or a Stack::Object
+ * type (StVec3, a host type, or rpn::Stack::Object for any type), by
+ * value or const reference.  The thunk only runs after its validator
+ * accepted the stack, so the arguments are static_cast in place; a
+ * result of the same type as the deepest argument is assigned over it
+ * instead of being allocated.
+ */
+namespace rpn {
+  namespace bind {
+    // parameter and result types to stack object types, any other
+    // parameter is a Stack::Object type itself (built-in or registered)
+    template<typename T> struct Slot { using St = T; };
+    template<> struct Slot<double> { using St = StDouble; };
+    template<> struct Slot<int64_t> { using St = StInteger; };
+    template<> struct Slot<bool> { using St = StBoolean; };
+    template<> struct Slot<std::string> { using St = StString; };
+
+    template<typename St> struct Get {
+      static const St &get(const rpn::Stack::Object &ob) { return static_cast<const St&>(ob); }
+    };
+    template<typename T> struct Get<TStackObject<T>> {
+      static auto get(const rpn::Stack::Object &ob) { return static_cast<const TStackObject<T>&>(ob).val(); }
+    };
+
+    template<typename R, typename St = typename Slot<R>::St> struct Put {
+      static void push(rpn::Stack &stack, const R &r) { stack.push(St(r)); }
+      static void assign(rpn::Stack::Object &ob, const R &r) { static_cast<St&>(ob).inner() = r; }
+    };
+    template<typename R> struct Put<R, R> {
+      static void push(rpn::Stack &stack, const R &r) { stack.push(r); }
+      static void assign(rpn::Stack::Object &ob, const R &r) { static_cast<R&>(ob) = r; }
+    };
+
+    // the result can be assigned over the deepest argument
+    template<typename... T> struct Front { using type = void; };
+    template<typename T, typename... U> struct Front<T, U...> { using type = T; };
+    template<typename R, typename... On> struct InPlace {
+      static constexpr bool value = std::is_same_v<typename Front<On...>::type, typename Slot<R>::St>;
+    };
+    template<typename... On> struct InPlace<void, On...> : std::false_type {};
+
+    template<typename Fn> struct Signature;
+    template<typename R, typename... A> struct Signature<R (*)(A...)> {
+      using Ret = std::decay_t<R>;
+      using Args = std::tuple<std::decay_t<A>...>;
+    };
+
+    // F called with the top items of the stack, known to be of the types On (deepest first)
+    template<auto F, typename... On>
+    struct Thunk {
+      static constexpr int n = sizeof...(On);
+      using R = typename Signature<decltype(F)>::Ret;
+      static constexpr bool in_place = InPlace<R, On...>::value;
+
+      static const rpn::StrictTypeValidator &validator() {
+	static const rpn::StrictTypeValidator v(types());
+	return v;
+      }
+
+      static rpn::WordDefinition::Result eval(rpn::Interp &rpn, rpn::WordContext *ctx, std::string &rest) {
+	call(rpn.stack, std::index_sequence_for<On...>{});
+	return rpn::WordDefinition::Result::ok;
+      }
+
+    private:
+      static std::vector<rpn::TypeId> types() {
+	std::vector<rpn::TypeId> rv { rpn::Types::of<On>()... };
+	return std::vector<rpn::TypeId>(rv.rbegin(), rv.rend()); // [0] is the top of stack
+      }
+
+      template<size_t... I>
+      static void call(rpn::Stack &stack, std::index_sequence<I...>) {
+	if constexpr (std::is_void_v<R>) {
+	  F(Get<On>::get(stack.peek(n-(int)I))...);
+	  stack.dropn(n);
+	} else {
+	  R r = F(Get<On>::get(stack.peek(n-(int)I))...);
+	  if constexpr (in_place) {
+	    stack.modify(n, [&r](rpn::Stack::Object &ob) { Put<R>::assign(ob, r); });
+	    stack.dropn(n-1);
+	  } else {
+	    stack.dropn(n);
+	    Put<R>::push(stack, r);
+	  }
+	}
+      }
+    };
+
+    template<typename T>
+    bool define(rpn::Interp &rpn, const std::string &word, rpn::WordContext *ctx) {
+      return rpn.addDefinition(word, { T::validator(), T::eval, ctx, T::eval });
+    }
+
+    template<auto F, typename Args> struct Strict;
+    template<auto F, typename... A> struct Strict<F, std::tuple<A...>> {
+      using type = Thunk<F, typename Slot<A>::St...>;
+    };
+
+    template<auto F>
+    bool add(rpn::Interp &rpn, const std::string &word, rpn::WordContext *ctx=nullptr) {
+      return define<typename Strict<F, typename Signature<decltype(F)>::Args>::type>(rpn, word, ctx);
+    }
+
+    // bit i of mask set: parameter i is an integer on the stack
+    template<auto DF, auto IF, size_t mask, size_t... I>
+    bool add_mask(rpn::Interp &rpn, const std::string &word, rpn::WordContext *ctx, std::index_sequence<I...>) {
+      constexpr size_t all = (size_t(1) << sizeof...(I)) - 1;
+      if constexpr (mask == all) {
+	return define<Thunk<IF, std::conditional_t<((mask >> I) & 1) != 0, StInteger, StDouble>...>>(rpn, word, ctx);
+      } else {
+	return define<Thunk<DF, std::conditional_t<((mask >> I) & 1) != 0, StInteger, StDouble>...>>(rpn, word, ctx);
+      }
+    }
+
+    template<auto DF, auto IF, size_t... M>
+    bool add_masks(rpn::Interp &rpn, const std::string &word, rpn::WordContext *ctx, std::index_sequence<M...>) {
+      constexpr size_t n = std::tuple_size_v<typename Signature<decltype(DF)>::Args>;
+      return (add_mask<DF, IF, M>(rpn, word, ctx, std::make_index_sequence<n>{}) & ...);
+    }
+
+    // like ADD_NATIVE_2_NUMBER_WDEF: DF for any mix of doubles and
+    // integers, IF when they are all integers
+    template<auto DF, auto IF>
+    bool add_number(rpn::Interp &rpn, const std::string &word, rpn::WordContext *ctx=nullptr) {
+      constexpr size_t n = std::tuple_size_v<typename Signature<decltype(DF)>::Args>;
+      static_assert(n == std::tuple_size_v<typename Signature<decltype(IF)>::Args>, "DF and IF take the same parameters");
+      return add_masks<DF, IF>(rpn, word, ctx, std::make_index_sequence<(size_t(1) << n)>{});
+    }
+  }
+}
+
 /* end of qinc/rpn-lang/rpn.h */
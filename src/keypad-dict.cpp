@@ -15,7 +15,7 @@
 #include "../rpn.h"
 
 static const rpn::StrictTypeValidator skAssignValidator({
-    typeid(StString).hash_code(), typeid(StString).hash_code(),typeid(StInteger).hash_code(), typeid(StInteger).hash_code()
+    rpn::Types::t_string, rpn::Types::t_string, rpn::Types::t_integer, rpn::Types::t_integer
       });
 
 NATIVE_WORD_DECL(keypad, ASSIGN_KEY) {
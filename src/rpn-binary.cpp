@@ -0,0 +1,373 @@
+/***************************************************
+ * file: qinc/rpn-lang/src/rpn-binary.cpp
+ *
+ * @file    rpn-binary.cpp
+ * @author  Eric L. Hernes
+ * @born_on   Friday, October 16, 2026
+ * @copyright (C) Copyright Eric L. Hernes 2026
+ * @copyright (C) Copyright Q, Inc. 2026
+ *
+ * @brief   An Eric L. Hernes Signature Series C++ module
+ *
+ * Binary encoding of stack objects, see StackWriter in rpn.h.
+ *
+ * Version 1 layout, all numbers little endian:
+ *
+ *   header   "RPNS" u16:version u16:flags(0)
+ *   object   u8:tag payload
+ *     double   u64 (IEEE bits)       integer  u64 (two's complement)
+ *     boolean  u8                    string   size bytes
+ *     vec3     3 x double            array    size object...
+ *     object   size (string object)...
+ *   end      u8:0
+ *
+ * where size is an unsigned LEB128.  Both ends buffer in 64k chunks;
+ * the reader reads ahead, so it owns the rest of the stream.
+ */
+
+#include "../rpn.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <istream>
+#include <ostream>
+
+namespace {
+  constexpr char magic[4] = { 'R', 'P', 'N', 'S' };
+  constexpr size_t chunk = 64 * 1024;
+  constexpr uint8_t tag_end = rpn::Types::none;
+}
+
+/*
+ * writer
+ */
+rpn::StackWriter::StackWriter(std::ostream &os) : _os(os) {
+  _buf.reserve(chunk + 64);
+  put(magic, sizeof(magic));
+  put_u8(version & 0xff);
+  put_u8(version >> 8);
+  put_u8(0); // flags
+  put_u8(0);
+}
+
+rpn::StackWriter::~StackWriter() {
+  try {
+    close();
+  } catch(const std::exception &e) {
+    printf("StackWriter: %s\n", e.what());
+  }
+}
+
+void
+rpn::StackWriter::close() {
+  // no end tag after a failed write, a reader sees the stream as truncated
+  if (!_closed && !_failed) {
+    _closed = true;
+    put_u8(tag_end);
+    flush();
+    _os.flush();
+  }
+}
+
+void
+rpn::StackWriter::flush() {
+  _os.write(_buf.data(), _buf.size());
+  _buf.clear();
+  if (!_os) {
+    _failed = true;
+    throw std::runtime_error("StackWriter: write failed");
+  }
+}
+
+void
+rpn::StackWriter::put(const void *p, size_t n) {
+  if (_buf.size() + n > chunk) {
+    flush();
+    if (n > chunk) {
+      _os.write(static_cast<const char*>(p), n);
+      return;
+    }
+  }
+  _buf.append(static_cast<const char*>(p), n);
+}
+
+void
+rpn::StackWriter::put_u8(uint8_t v) {
+  put(&v, 1);
+}
+
+void
+rpn::StackWriter::put_u64(uint64_t v) {
+  uint8_t b[8];
+  for(int i=0; i<8; i++) {
+    b[i] = (uint8_t)(v >> (8*i));
+  }
+  put(b, sizeof(b));
+}
+
+void
+rpn::StackWriter::put_size(size_t v) {
+  uint8_t b[10];
+  size_t n = 0;
+  do {
+    b[n] = (uint8_t)(v & 0x7f);
+    v >>= 7;
+    if (v) {
+      b[n] |= 0x80;
+    }
+    n++;
+  } while(v);
+  put(b, n);
+}
+
+void
+rpn::StackWriter::put_string(const std::string &s) {
+  put_size(s.size());
+  put(s.data(), s.size());
+}
+
+static uint64_t
+double_bits(double d) {
+  uint64_t rv;
+  std::memcpy(&rv, &d, sizeof(rv));
+  return rv;
+}
+
+void
+rpn::StackWriter::write(const Stack::Object &ob) {
+  if (_closed) {
+    throw std::runtime_error("StackWriter: write after close");
+  }
+  try {
+    encode(ob);
+  } catch(...) {
+    _failed = true;
+    throw;
+  }
+}
+
+void
+rpn::StackWriter::encode(const Stack::Object &ob) {
+  TypeId tag = ob.type_id();
+  switch(tag) {
+  case Types::t_double:
+    put_u8(tag);
+    put_u64(double_bits(static_cast<const StDouble&>(ob).val()));
+    break;
+  case Types::t_integer:
+    put_u8(tag);
+    put_u64((uint64_t)(int64_t)static_cast<const StInteger&>(ob).val());
+    break;
+  case Types::t_boolean:
+    put_u8(tag);
+    put_u8((bool)static_cast<const StBoolean&>(ob).val() ? 1 : 0);
+    break;
+  case Types::t_string:
+    put_u8(tag);
+    put_string(ob.to_string());
+    break;
+  case Types::t_vec3: {
+    auto &v = static_cast<const StVec3&>(ob);
+    put_u8(tag);
+    put_u64(double_bits(v._x));
+    put_u64(double_bits(v._y));
+    put_u64(double_bits(v._z));
+    break;
+  }
+  case Types::t_array: {
+    auto &v = static_cast<const StArray&>(ob).inner().val();
+    put_u8(tag);
+    put_size(v.size());
+    for(auto const &e : v) {
+      encode(*e);
+    }
+    break;
+  }
+  case Types::t_object: {
+    auto &v = static_cast<const StObject&>(ob).inner().val();
+    put_u8(tag);
+    put_size(v.size());
+    for(auto const &m : v) {
+      put_string(m.first);
+      encode(*m.second);
+    }
+    break;
+  }
+  default:
+    throw std::runtime_error("StackWriter: no binary encoding for type '" + Types::name(tag) + "'");
+  }
+}
+
+/*
+ * reader
+ */
+rpn::StackReader::StackReader(std::istream &is) : _is(is) {
+  char m[sizeof(magic)];
+  get(m, sizeof(m));
+  if (std::memcmp(m, magic, sizeof(magic)) != 0) {
+    throw std::runtime_error("StackReader: not a stack stream");
+  }
+  _version = get_u8();
+  _version |= (uint16_t)(get_u8() << 8);
+  uint16_t flags = get_u8();
+  flags |= (uint16_t)(get_u8() << 8);
+  if (_version == 0 || _version > StackWriter::version || flags != 0) {
+    throw std::runtime_error("StackReader: unsupported version " + std::to_string(_version));
+  }
+}
+
+void
+rpn::StackReader::fill(size_t n) {
+  size_t have = _buf.size() - _pos;
+  if (have >= n) {
+    return;
+  }
+  _buf.erase(_buf.begin(), _buf.begin() + _pos);
+  _pos = 0;
+  size_t want = std::max(n - have, chunk);
+  _buf.resize(have + want);
+  _is.read(_buf.data() + have, want);
+  _buf.resize(have + _is.gcount());
+  if (_buf.size() < n) {
+    throw std::runtime_error("StackReader: truncated stream");
+  }
+}
+
+void
+rpn::StackReader::get(void *p, size_t n) {
+  fill(n);
+  std::memcpy(p, _buf.data() + _pos, n);
+  _pos += n;
+}
+
+uint8_t
+rpn::StackReader::get_u8() {
+  fill(1);
+  return (uint8_t)_buf[_pos++];
+}
+
+uint64_t
+rpn::StackReader::get_u64() {
+  uint8_t b[8];
+  get(b, sizeof(b));
+  uint64_t rv = 0;
+  for(int i=0; i<8; i++) {
+    rv |= (uint64_t)b[i] << (8*i);
+  }
+  return rv;
+}
+
+size_t
+rpn::StackReader::get_size() {
+  uint64_t rv = 0;
+  for(unsigned shift=0; shift<64; shift+=7) {
+    uint8_t b = get_u8();
+    rv |= (uint64_t)(b & 0x7f) << shift;
+    if ((b & 0x80) == 0) {
+      return (size_t)rv;
+    }
+  }
+  throw std::runtime_error("StackReader: bad size");
+}
+
+std::string
+rpn::StackReader::get_string() {
+  // in chunks, so a corrupt size fails as truncated rather than as a huge allocation
+  size_t n = get_size();
+  std::string rv;
+  while(n) {
+    size_t part = std::min(n, chunk);
+    fill(part);
+    rv.append(_buf.data() + _pos, part);
+    _pos += part;
+    n -= part;
+  }
+  return rv;
+}
+
+static double
+bits_double(uint64_t bits) {
+  double rv;
+  std::memcpy(&rv, &bits, sizeof(rv));
+  return rv;
+}
+
+std::unique_ptr<rpn::Stack::Object>
+rpn::StackReader::read() {
+  if (_end) {
+    return nullptr;
+  }
+  uint8_t tag = get_u8();
+  if (tag == tag_end) {
+    _end = true;
+    return nullptr;
+  }
+  return read(tag);
+}
+
+std::unique_ptr<rpn::Stack::Object>
+rpn::StackReader::read(uint8_t tag) {
+  switch(tag) {
+  case Types::t_double:
+    return std::make_unique<StDouble>(bits_double(get_u64()));
+  case Types::t_integer:
+    return std::make_unique<StInteger>((int64_t)get_u64());
+  case Types::t_boolean:
+    return std::make_unique<StBoolean>(get_u8() != 0);
+  case Types::t_string:
+    return std::make_unique<StString>(get_string());
+  case Types::t_vec3: {
+    double x = bits_double(get_u64());
+    double y = bits_double(get_u64());
+    double z = bits_double(get_u64());
+    return std::make_unique<StVec3>(x, y, z);
+  }
+  case Types::t_array: {
+    auto rv = std::make_unique<StArray>();
+    for(size_t n=get_size(); n>0; n--) {
+      rv->inner().add_value(read(get_u8()));
+    }
+    return rv;
+  }
+  case Types::t_object: {
+    auto rv = std::make_unique<StObject>();
+    for(size_t n=get_size(); n>0; n--) {
+      std::string name = get_string();
+      rv->inner().add_value(name, read(get_u8()));
+    }
+    return rv;
+  }
+  default:
+    throw std::runtime_error("StackReader: bad tag " + std::to_string(tag));
+  }
+}
+
+/*
+ * whole stack, bottom first
+ */
+void
+rpn::Stack::save(std::ostream &os) const {
+  StackWriter w(os);
+  for(auto const &ob : _stack) {
+    w.write(*ob);
+  }
+  w.close();
+}
+
+void
+rpn::Stack::load(std::istream &is) {
+  StackReader r(is);
+  std::vector<std::unique_ptr<Object>> items;
+  size_t bytes = 0;
+  for(auto ob = r.read(); ob; ob = r.read()) {
+    bytes += ob->footprint();
+    items.push_back(std::move(ob));
+  }
+  _stack = std::move(items);
+  _bytes = bytes;
+  _dirty = 0;
+  _changed = 0;
+}
+
+/* end of qinc/rpn-lang/src/rpn-binary.cpp */
@@ -13,12 +13,17 @@
  */
 
 #include <fstream>
-#include <queue>
+#include <deque>
 #include <future>
+#include <thread>
 #include <mutex>
+#include <atomic>
+#include <list>
 #include <set>
+#include <algorithm>
 
 #include "../rpn.h"
+#include "rpn-jit.h"
 
 std::string
 rpn::to_string(const double &dv) {
@@ -41,6 +46,51 @@ nextWord(std::string &word, std::string &buffer, const std::string &delim=" \n\t
   return p1;
 }
 
+// the word definitions in a file's lines in order, each as one line of
+// source; comments are dropped, editing them doesn't change a definition
+static std::vector<std::pair<std::string,std::string>>
+definitions(const std::vector<std::string> &lines) {
+  std::vector<std::pair<std::string,std::string>> rv;
+  bool in = false;
+  for(auto line : lines) {
+    while(line.size()>0) {
+      std::string word, skip;
+      nextWord(word, line);
+      if (word.empty()) {
+	continue;
+      }
+      if (word == "(") {
+	nextWord(skip, line, ")");
+	continue;
+      }
+      if (!in) {
+	if (word == ":") {
+	  rv.emplace_back("", ":");
+	  in = true;
+	} else if (word == ".\"") {
+	  nextWord(skip, line, "\"");
+	}
+	continue;
+      }
+      auto &def = rv.back();
+      if (def.first.empty()) {
+	def.first = word;
+      }
+      def.second += " " + word;
+      if (word == ".\"") {
+	nextWord(skip, line, "\"");
+	def.second += " " + skip + "\"";
+      } else if (word == ";") {
+	in = false;
+      }
+    }
+  }
+  if (in) {
+    rv.pop_back(); // unterminated, parseFile reports it
+  }
+  return rv;
+}
+
 using var_dict_t = std::map<std::string,std::unique_ptr<rpn::Stack::Object>>;
 
 enum CompileType {
@@ -51,24 +101,22 @@ enum CompileType {
   ct_mathexpr
 };
 
-struct Progn : public rpn::WordContext, public rpn::Stack::Object {
+/*
+ * A compiled body.  It is built in place on the compile stack, moved out
+ * by end_compile and shared from then on, whether it is installed in the
+ * dictionary, running or nested in another body; it is never copied.
+ * It is released when the last of those lets go.
+ */
+struct Progn : public rpn::WordContext, public std::enable_shared_from_this<Progn> {
 public:
-  Progn(rpn::Interp::Privates &p, CompileType t) : _p(p), _type(t) { _locals = std::make_shared<var_dict_t>(); };
-  Progn(const Progn &other) : _p(other._p), _wordlist(other._wordlist), _type(other._type), _ident(other._ident) {
-    _locals = std::make_shared<var_dict_t>();
-    for(auto const &v : *other._locals) {
-      _locals->emplace(v.first, v.second->deep_copy());
-    }
-  }
+  Progn(rpn::Interp::Privates &p, CompileType t);
+  ~Progn();
+  Progn(const Progn &other) = delete;
+  Progn &operator=(const Progn &other) = delete;
 
-  virtual bool operator==(const Object &orhs) const override {
-    auto &rhs = PEEK_CAST(const Progn,orhs);
-    return ((_type == rhs._type) &&
-	    (_wordlist == rhs._wordlist) &&
-	    (_locals == rhs._locals));
-  }
+  struct Code;
 
-  virtual operator std::string() const override {
+  operator std::string() const {
     std::string rv = "<<";
     for(auto const &w : _wordlist) {
       rv += " ";
@@ -77,20 +125,43 @@ public:
     rv += ">>";
     return rv;
   };
-  virtual std::unique_ptr<rpn::Stack::Object> deep_copy() const override { return std::make_unique<Progn>(*this); };
-
-  void addWord(const std::string &word) { _wordlist.push_back(word); };
+  void addWord(const std::string &word) { _wordlist.push_back(word); _ctl.push_back({ Ctl::word, 0 }); };
 
   rpn::WordDefinition::Result eval(rpn::Interp &rpn);
 
   rpn::WordDefinition::Result eval_forloop(rpn::Interp &rpn);
   rpn::WordDefinition::Result eval_whileloop(rpn::Interp &rpn);
-  rpn::WordDefinition::Result eval_lambda(rpn::Interp &rpn);
+  rpn::WordDefinition::Result eval_lambda(rpn::Interp &rpn, std::shared_ptr<const Code> run=nullptr);
   rpn::WordDefinition::Result eval_mathexpr(rpn::Interp &rpn);
 
   const std::vector<std::string> &wordlist() const { return _wordlist; };
 
-  void clear() { _wordlist.clear(); };
+  void clear() { _wordlist.clear(); _ctl.clear(); };
+  void dropWords(size_t n) { _wordlist.resize(_wordlist.size()-n); _ctl.resize(_ctl.size()-n); };
+
+  // control flow compiled into the word stream
+  struct Ctl {
+    enum Op : uint8_t {
+      word,    // evaluate _wordlist[pc]
+      branch0, // pop a condition, jump if it is false (IF WHILE UNTIL)
+      branch,  // jump (ELSE REPEAT ENDOF)
+      of,      // pop a value, jump unless it equals the CASE selector, else drop the selector
+      nested,  // evaluate _nested[target] (a loop or EVAL expression)
+    } op;
+    uint32_t target;
+    bool jumps() const { return op == branch0 || op == branch || op == of; }
+  };
+  size_t addJump(const std::string &word, Ctl::Op op, size_t target=0) {
+    _wordlist.push_back(word);
+    _ctl.push_back({ op, (uint32_t)target });
+    return _ctl.size()-1;
+  }
+  void patch(size_t jump) { _ctl[jump].target = (uint32_t)_ctl.size(); } // to the next word compiled
+  void addNested(std::shared_ptr<Progn> progn) {
+    _wordlist.push_back(std::string("<") + (progn->_ident.size() ? progn->_ident : "expr") + ">");
+    _ctl.push_back({ Ctl::nested, (uint32_t)_nested.size() });
+    _nested.push_back(std::move(progn));
+  }
 
   void print() {
     std::string str = (std::string)(*this);
@@ -106,9 +177,90 @@ public:
     
   rpn::Interp::Privates &_p;
   std::vector<std::string> _wordlist;
+  std::vector<Ctl> _ctl; // parallel to _wordlist
+  std::vector<std::pair<std::string,size_t>> _open; // IF, ELSE, CASE, ... waiting for their end while compiling
+  std::vector<std::shared_ptr<Progn>> _nested; // loop bodies and EVAL expressions compiled inside this one
   std::shared_ptr<var_dict_t> _locals;
   CompileType _type;
   std::string _ident; // value and usage depends on type
+  std::shared_ptr<rpn::jit::Kernel> _native; // set for pure numeric words when NATIVE is on
+
+  // call sites bound to their definition for one set of entry types, so
+  // that words proven to fit skip the validators
+  struct Site {
+    const rpn::WordDefinition *def; // nullptr is validated at runtime
+    bool local;                     // inferred as a local variable
+    bool known;                     // false if the types here couldn't be inferred
+  };
+  struct Binding {
+    uint64_t generation;
+    const Code *code;          // what it was inferred for
+    std::vector<rpn::TypeId> entry; // types of the stack items the body reads, [0] is tos
+    std::vector<std::pair<std::string,rpn::TypeId>> locals; // types of the locals it reads
+    std::vector<Site> sites;   // parallel to the Code it was inferred for
+  };
+  std::vector<std::shared_ptr<const Binding>> _bindings;
+
+  // the body as it runs: small compiled words it calls are spliced in,
+  // it is rebuilt for each dictionary generation so that callers see
+  // redefinitions, while running frames keep the code they started with
+  struct LoopPlan;
+  struct Code {
+    uint64_t generation;
+    std::vector<std::string> wordlist;
+    std::vector<Ctl> ctl;
+    std::shared_ptr<const LoopPlan> loop; // FOR bodies rewritten by plan_loop
+    std::shared_ptr<const Code> plain;    // and the body as it was before
+  };
+  std::shared_ptr<const Code> _code;
+  std::vector<std::string> _scope; // loop variables visible in this body
+
+  // an installed word's code and bindings are rebuilt when a word it uses
+  // changes (Privates::changed), anything else's on every dictionary change
+  uint64_t stamp() const;
+  void restamp(uint64_t epoch);
+  void uses(std::set<std::string> &words) const; // this body and its loops call
+  uint64_t _epoch = 0;
+  bool _tracked = false;
+
+  // counted in Privates::_prognBytes: the compiled source, not the code caches
+  size_t _bytes = 0;
+  void account();
+  bool _expanding = false;
+  std::shared_ptr<const Code> code();
+  Progn *inlineable(const std::string &word);
+  bool unroll(size_t pc, Code &c);
+
+  // what eval_forloop does around a FOR body rewritten by plan_loop: the
+  // values that are the same in every iteration are computed once, by
+  // the preheader, into %hN locals; the values affine in the loop
+  // variable are computed natively into %nN locals for each iteration
+  struct LoopPlan {
+    std::shared_ptr<Progn> preheader; // pushes the hoisted values in order
+    std::vector<std::string> hoisted; // their locals, "" if only used by the terms
+    struct Term {
+      enum Kind : uint8_t { index, hoisted, constant, add, sub, mul, div, scaled } kind;
+      uint32_t a, b; // operand terms, the hoisted value; scaled is term a times the index
+      double k;
+    };
+    std::vector<Term> terms; // operands before their uses
+    std::vector<std::pair<std::string,uint32_t>> inductions;
+  };
+  std::shared_ptr<const LoopPlan> plan_loop(const Code &in, Code &out);
+  bool start_loop(rpn::Interp &rpn, const LoopPlan &plan, double start, double end, std::vector<double> &v);
+  void step_loop(const LoopPlan &plan, double i, std::vector<double> &v);
+
+  std::shared_ptr<const Binding> binding(rpn::Interp &rpn, const Code &code);
+  std::shared_ptr<const Binding> infer(rpn::Interp &rpn, const Code &code);
+
+  // the body as a native kernel for worker threads (MAP, REDUCE, PARFOR),
+  // with a loop's variable as its parameter; nullptr if it won't compile
+  std::shared_ptr<const rpn::jit::Kernel> kernel();
+  std::shared_ptr<const rpn::jit::Kernel> _kernel;
+  std::shared_ptr<const Code> _kernelCode; // what _kernel was compiled from
+
+  bool _parallel = false; // PARFOR
+  bool eval_parfor(rpn::Interp &rpn, double start, double end, rpn::WordDefinition::Result &rv);
 };
 
 #include <chrono>
@@ -116,7 +268,7 @@ using namespace std::chrono_literals;
 
 struct rpn::Interp::Privates : public rpn::WordContext {
   std::future<void> _arv;
-  Privates(rpn::Interp &rpn) : _rpn(rpn), _tracing(false) {
+  Privates(rpn::Interp &rpn) : _rpn(rpn), _tracing(false), _nativeCode(false) {
     _arv = std::async(std::launch::async, &rpn::Interp::Privates::main_loop, this);
   };
   ~Privates() {
@@ -130,9 +282,10 @@ struct rpn::Interp::Privates : public rpn::WordContext {
       case std::future_status::ready: printf("ready!\n"); break;
       }
     } while (status != std::future_status::ready);
+    stop_pump(true);
   };
 
-  rpn::WordDefinition::Result eval(const std::string &word, std::string &rest);
+  rpn::WordDefinition::Result eval(const std::string &word, std::string &rest, const rpn::WordDefinition *bound=nullptr);
   rpn::WordDefinition::Result runtime_eval(const std::string &word, std::string &rest);
   rpn::WordDefinition::Result compiletime_eval(const std::string &word, std::string &rest);
 
@@ -142,42 +295,279 @@ struct rpn::Interp::Privates : public rpn::WordContext {
   // validates a word in the dictionary and returns an iterator to it (or _rtDictionary.end() )
   std::multimap<std::string,WordDefinition>::iterator validate_word(const std::string &word, rpn::Stack &stack);
   bool word_exists(const std::string &word);
+  // the definition runtime_eval would call for a dictionary word, nullptr for anything else
+  const rpn::WordDefinition *resolve(const std::string &word);
+  // every definition of the word is built in, a user word could be redefined later
+  bool builtin(const std::string &word);
+  // the native kernel of a compiled word that takes 'inputs' values and leaves one
+  std::shared_ptr<const rpn::jit::Kernel> parallel_kernel(const std::string &word, size_t inputs);
+  // runs that went parallel, see Interp::parallelStats()
+  std::atomic<uint64_t> _parallelMap {0};
+  std::atomic<uint64_t> _parallelReduce {0};
+  std::atomic<uint64_t> _parallelFor {0};
 
   rpn::WordDefinition::Result start_compile(CompileType t, bool needIdent);
-  rpn::WordDefinition::Result end_compile(Progn *&progp, CompileType t);
+  rpn::WordDefinition::Result end_compile(std::shared_ptr<Progn> &progp, CompileType t);
+  rpn::WordDefinition::Result close_lambda();
 
   bool is_local_variable(const std::string &word);
   bool find_local_variable(var_dict_t::const_iterator &var, const std::string &word);
 
+  // compiles (once) an algebraic expression for EVAL
+  std::shared_ptr<Progn> compile_mathexpr(const std::string &expr);
+
   rpn::WordDefinition::Result parse(std::string &line) {
     rpn::WordDefinition::Result rv=rpn::WordDefinition::Result::ok;
     for(; rv==rpn::WordDefinition::Result::ok && line.size()>0;) {
       std::string word;
       auto p1 = nextWord(word,line);
-      rv = eval(word, line);
+      rv = (stopping()) ? rpn::WordDefinition::Result::cancelled : eval(word, line);
     }
     return rv;
   }
 
-  rpn::WordDefinition::Result sync_parse_file(const std::string &path) {
-    rpn::WordDefinition::Result rv=rpn::WordDefinition::Result::ok;
-    std::ifstream ifs(path);
+  /*
+   * a queued request and its budget, the slices of a file share one
+   */
+  struct Run {
+    uint64_t id;
+    size_t lane; // rpn::Interp::Priority
+    std::chrono::steady_clock::time_point queued;
+    bool started = false;
+    rpn::Interp::Budget budget;
+    uint64_t words = 0;
+    std::chrono::steady_clock::duration used {};
+    bool loaded = false; // parseFile: lines[next] is the next to parse
+    std::vector<std::string> lines;
+    size_t next = 0;
+  };
+
+  // limits of the running slice, checked once a word by eval_lambda and parse
+  uint64_t _words = 0;
+  uint64_t _wordLimit = UINT64_MAX;
+  std::chrono::steady_clock::time_point _deadline = std::chrono::steady_clock::time_point::max();
+  std::atomic<uint64_t> _runId {0}; // 0 between requests
+  std::atomic<uint64_t> _cancelId {UINT64_MAX};
+  uint64_t _lastId = 0;
+  rpn::Interp::Budget _budget;
+  std::atomic<int64_t> _quantumMs {50}; // Interp::quantum()
+
+  // after a request, or a slice of one
+  void finish(rpn::WordDefinition::Result rv) {
+    if (rv == rpn::WordDefinition::Result::cancelled || rv == rpn::WordDefinition::Result::memory_error) {
+      _ctVprogn.clear(); // a definition it was in the middle of
+    }
+    if (rv == rpn::WordDefinition::Result::memory_error) {
+      _rpn.stack.rollback(); // whatever took it over the limit
+    }
+    over_limit(); // the high water mark
+  }
+
+  bool stopping() {
+    if (++_words < _wordLimit && (_words & 0x3ff) != 0 &&
+	_cancelId.load(std::memory_order_relaxed) != _runId.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    return over_budget();
+  }
+
+  bool over_budget() {
+    const char *why = nullptr;
+    if (_cancelId.load() == _runId.load()) {
+      why = "cancelled";
+    } else if (_words >= _wordLimit) {
+      why = "word budget exhausted";
+    } else if ((_words & 0x3ff) == 0 && std::chrono::steady_clock::now() >= _deadline) {
+      why = "time budget exhausted";
+    }
+    if (why && _tracing) {
+      printf("stopping: %s after %llu words\n", why, (unsigned long long)_words);
+    }
+    return why != nullptr;
+  }
+
+  // a word waiting on something else gives up when the request can't go on
+  bool interrupted() {
+    return !_running || _cancelId.load() == _runId.load() || std::chrono::steady_clock::now() >= _deadline;
+  }
+
+  // SEND writes here, the host drains it or a pump thread sends it to _sink
+  rpn::OutputChannel _output;
+  std::shared_ptr<rpn::OutputSink> _sink;
+  std::thread _pump;
+  std::atomic<bool> _pumping {false};
+  void output_sink(std::shared_ptr<rpn::OutputSink> sink) {
+    stop_pump(false);
+    if (sink) {
+      _sink = sink;
+      _pumping = true;
+      _pump = std::thread([this, sink]{
+	while(_pumping) {
+	  if (_output.wait_data(100ms)) {
+	    _output.drain([&sink](const rpn::OutputChannel::Batch &b) { sink->write(b); });
+	  }
+	}
+      });
+    }
+  }
+  // 'flush' hands the sink what is still in the channel, at shutdown
+  void stop_pump(bool flush) {
+    if (_pump.joinable()) {
+      _pumping = false;
+      _output.wake();
+      _pump.join();
+    }
+    if (flush && _sink) {
+      while(_output.drain([this](const rpn::OutputChannel::Batch &b) { _sink->write(b); })) {
+      }
+    }
+    _sink = nullptr;
+  }
+
+  void start_slice(Run &run) {
+    _words = run.words;
+    _wordLimit = (run.budget.words) ? run.budget.words : UINT64_MAX;
+    _deadline = std::chrono::steady_clock::time_point::max();
+    if (run.budget.time.count()) {
+      _deadline = std::chrono::steady_clock::now() + (run.budget.time - run.used);
+    }
+    _runId = run.id;
+  }
+
+  void end_slice(Run &run, std::chrono::steady_clock::time_point started) {
+    run.words = _words;
+    run.used += std::chrono::steady_clock::now() - started;
+    _runId = 0;
+    _wordLimit = UINT64_MAX;
+    _deadline = std::chrono::steady_clock::time_point::max();
+  }
+
+  // false when it stopped early to let queued requests run, the rest
+  // of the file goes back on the queue
+  bool sync_parse_file(const std::string &path, Run &run, rpn::WordDefinition::Result &rv, bool slice=true) {
+    rv=rpn::WordDefinition::Result::ok;
+    if (!run.loaded) {
+      run.lines = read_lines(path);
+      run.loaded = true;
+    }
 
-    // XXX-ELH: do we really need to stuff this into a vector before we parse it?
+    // a slice runs a line at least, the starvation rule picks a bulk
+    // file while keypresses are waiting and it has to get somewhere
+    size_t first = run.next;
+    std::chrono::milliseconds quantum(_quantumMs.load());
+    auto yield = std::chrono::steady_clock::now() + quantum;
+    for(; run.next<run.lines.size() && rv==rpn::WordDefinition::Result::ok; run.next++) {
+      if (slice && _ctVprogn.empty() && run.next > first &&
+	  ((run.lane != 0 && _urgent.load(std::memory_order_relaxed)) ||
+	   (quantum.count() && std::chrono::steady_clock::now() >= yield && waiting()))) {
+	return false;
+      }
+      std::string line = run.lines[run.next]; // kept for remember_module
+      rv = parse(line);
+      if (rv != rpn::WordDefinition::Result::ok) {
+	printf("parse error at %s:%zu\n", path.c_str(), run.next);
+      }
+    }
+    if (rv == rpn::WordDefinition::Result::ok) {
+      remember_module(path, definitions(run.lines));
+    }
+    return true;
+  }
+
+  static std::vector<std::string> read_lines(const std::string &path) {
+    std::ifstream ifs(path);
     std::string tmp;
-    std::vector<std::string> lines;
+    std::vector<std::string> rv;
     while(getline(ifs, tmp, '\n')) {
-      lines.push_back(tmp);
+      rv.push_back(tmp);
+    }
+    return rv;
+  }
+
+  void remember_module(const std::string &path, const std::vector<std::pair<std::string,std::string>> &defs) {
+    auto &m = _modules[path];
+    m.clear();
+    for(auto const &d : defs) {
+      m[d.first] = d.second;
+    }
+  }
+
+  // a file parsed before: only its definitions whose source changed are
+  // compiled again and the ones no longer there are forgotten, the rest of
+  // the file isn't run again; a new file is parsed as by parseFile
+  rpn::WordDefinition::Result sync_reload_file(const std::string &path) {
+    rpn::WordDefinition::Result rv=rpn::WordDefinition::Result::ok;
+    auto lines = read_lines(path);
+    auto defs = definitions(lines);
+    auto mi = _modules.find(path);
+    if (mi == _modules.end()) {
+      Run run;
+      run.lines = std::move(lines);
+      run.loaded = true;
+      sync_parse_file(path, run, rv, false);
+      return rv;
     }
 
-    int lineNo=0;
-    for(auto line = lines.begin(); line!=lines.end() && rv==rpn::WordDefinition::Result::ok; line++, lineNo++) {
-      rv = parse(*line);
+    size_t compiled = 0;
+    for(auto const &d : defs) {
+      auto old = mi->second.find(d.first);
+      if (old != mi->second.end() && old->second == d.second) {
+	continue;
+      }
+      std::string line = d.second;
+      rv = parse(line);
       if (rv != rpn::WordDefinition::Result::ok) {
-	printf("parse error at %s:%d\n", path.c_str(), lineNo);
+	printf("reload error in %s: '%s'\n", path.c_str(), d.first.c_str());
+	return rv;
+      }
+      compiled++;
+    }
+    for(auto const &old : mi->second) {
+      if (std::none_of(defs.cbegin(), defs.cend(), [&old](const std::pair<std::string,std::string> &d) { return d.first == old.first; })) {
+	retire(old.first);
+	changed(old.first);
+      }
+    }
+    if (_tracing) {
+      printf("reloaded %s: %zu of %zu definitions compiled\n", path.c_str(), compiled, defs.size());
+    }
+    remember_module(path, defs);
+    return rv;
+  }
+
+  rpn::WordDefinition::Result sync_save_stack(const std::string &path) {
+    // into a new file, the old one is replaced only once it is complete
+    rpn::WordDefinition::Result rv=rpn::WordDefinition::Result::ok;
+    std::string tmp = path + ".tmp";
+    try {
+      {
+	std::ofstream ofs(tmp, std::ios::binary);
+	_rpn.stack.save(ofs);
+	ofs.close();
+	if (!ofs) {
+	  throw std::runtime_error("write failed");
+	}
       }
+      if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+	throw std::runtime_error("can't replace it");
+      }
+    } catch(const std::exception &e) {
+      printf("save stack to %s: %s\n", path.c_str(), e.what());
+      std::remove(tmp.c_str());
+      rv = rpn::WordDefinition::Result::eval_error;
     }
+    return rv;
+  }
 
+  rpn::WordDefinition::Result sync_restore_stack(const std::string &path) {
+    rpn::WordDefinition::Result rv=rpn::WordDefinition::Result::ok;
+    std::ifstream ifs(path, std::ios::binary);
+    try {
+      _rpn.stack.load(ifs);
+    } catch(const std::exception &e) {
+      printf("restore stack from %s: %s\n", path.c_str(), e.what());
+      rv = rpn::WordDefinition::Result::eval_error;
+    }
     return rv;
   }
 
@@ -189,11 +579,146 @@ struct rpn::Interp::Privates : public rpn::WordContext {
   rpn::Interp &_rpn;
   std::string _status;
 
-  std::vector<Progn> _ctVprogn;
+  // compiled bodies alive, see Interp::memoryStats(); before the bodies so they outlast them
+  std::atomic<size_t> _installed {0};
+  std::atomic<size_t> _progns {0};
+  std::atomic<size_t> _prognBytes {0};
+
+  std::vector<std::unique_ptr<Progn>> _ctVprogn; // being compiled, innermost last
+  std::vector<std::shared_ptr<Progn>> _compiled;  // installed in the dictionary
+  std::map<std::string,std::set<Progn*>> _users;  // installed words by the words they use
+  std::map<std::string,std::map<std::string,std::string>> _modules; // parsed files' definitions by name
   std::vector<std::shared_ptr<var_dict_t>> _vlocals;
+  size_t _vlocalsFloor = 0; // a called word doesn't see its callers' locals
+
+  // compiled words calling compiled words run on this instead of the C++ stack
+  struct Frame {
+    std::shared_ptr<Progn> progn; // a running body outlives its redefinition
+    std::shared_ptr<const Progn::Code> code;
+    size_t pc; // return address while a callee runs
+    std::shared_ptr<const Progn::Binding> bound;
+    size_t floor; // _vlocalsFloor while this frame runs
+  };
+  std::vector<Frame> _rstack;
+
+  var_dict_t _globals; // STO/RCL and EVAL assignments
+  std::atomic<size_t> _globalBytes {0};
+
+  void store_global(const std::string &name, std::unique_ptr<rpn::Stack::Object> val) {
+    auto &slot = _globals[name];
+    size_t bytes = _globalBytes - ((slot) ? slot->footprint() : 0) + val->footprint();
+    slot = std::move(val);
+    _globalBytes = bytes;
+  }
+
+  // see Interp::memoryLimits(), checked after each word when set
+  std::atomic<size_t> _softLimit {0};
+  std::atomic<size_t> _hardLimit {0};
+  std::atomic<size_t> _peak {0};
+  std::atomic<bool> _overSoft {false}; // as of the last check, see MemoryStats::over_soft
+
+  size_t memory_used() {
+    return _rpn.stack.bytes() + _rpn.stack.history_bytes() + _prognBytes + _globalBytes;
+  }
+
+  // true when a word took the total from 'before' to past the hard limit
+  // and dropping undo history doesn't bring it back; one that doesn't
+  // add to it gets through, so a stack over the limit can be cut down.
+  // a warning when it goes over the soft one
+  bool over_limit(size_t before = 0) {
+    size_t used = memory_used();
+    if (used > _peak) {
+      _peak = used;
+    }
+    size_t soft = _softLimit;
+    if (soft && (used > soft) != _overSoft) {
+      _overSoft = (used > soft);
+      if (_overSoft && _tracing) {
+	printf("memory: %zu bytes in use, over the soft limit of %zu\n", used, soft);
+      }
+    }
+    size_t hard = _hardLimit;
+    if (!hard || used <= hard || used <= before) {
+      return false;
+    }
+    while(used > hard && _rpn.stack.trim_history()) {
+      used = memory_used();
+    }
+    return used > hard;
+  }
+  // EVAL programs by source text, the least recently used one goes past
+  // expr_cache_max (a running one lives on until it is done)
+  static constexpr size_t expr_cache_max = 256;
+  std::list<std::string> _exprOrder; // most recent first
+  std::map<std::string,std::pair<std::shared_ptr<Progn>,std::list<std::string>::iterator>> _exprCache;
 
   bool _needIdent;
   bool _tracing;
+  bool _nativeCode;
+  uint64_t _generation = 0; // bumped when the dictionary changes, invalidates bindings
+
+  void track(Progn *pg) {
+    std::set<std::string> words;
+    pg->uses(words);
+    for(auto const &w : words) {
+      _users[w].insert(pg);
+    }
+    pg->restamp(_generation);
+  }
+
+  void untrack(Progn *pg) {
+    std::set<std::string> words;
+    pg->uses(words);
+    for(auto const &w : words) {
+      auto ui = _users.find(w);
+      if (ui != _users.end() && ui->second.erase(pg) && ui->second.empty()) {
+	_users.erase(ui);
+      }
+    }
+  }
+
+  // the word was (re)defined or removed: the installed words that use it,
+  // and the ones that use those, rebuild their code and bindings
+  void changed(const std::string &word) {
+    _generation++;
+    std::vector<std::string> work { word };
+    std::set<Progn*> done;
+    while(!work.empty()) {
+      auto ui = _users.find(work.back());
+      work.pop_back();
+      if (ui == _users.end()) {
+	continue;
+      }
+      for(Progn *pg : ui->second) {
+	if (done.insert(pg).second) {
+	  pg->restamp(_generation);
+	  work.push_back(pg->_ident);
+	}
+      }
+    }
+    if (_tracing) {
+      printf("'%s' changed, %zu words to rebuild\n", word.c_str(), done.size());
+    }
+  }
+
+  // takes the compiled definitions of the word out of the dictionary
+  void retire(const std::string &word) {
+    auto range = _rtDictionary.equal_range(word);
+    for(auto we=range.first; we!=range.second; ) {
+      Progn *pg = dynamic_cast<Progn*>(we->second.context);
+      if (pg == nullptr) {
+	we++;
+	continue;
+      }
+      untrack(pg);
+      we = _rtDictionary.erase(we);
+      auto ci = std::find_if(_compiled.begin(), _compiled.end(), [pg](const std::shared_ptr<Progn> &c) { return c.get() == pg; });
+      if (ci != _compiled.end()) {
+	_compiled.erase(ci); // released now unless it is running
+	_installed--;
+      }
+    }
+  }
 
   std::mutex _qmx;
   std::condition_variable _qcv;
@@ -202,45 +727,230 @@ struct rpn::Interp::Privates : public rpn::WordContext {
     std::string cmd;
     std::string param;
     std::function<void(rpn::WordDefinition::Result res)> completionHandler;
+    std::shared_ptr<Run> run; // set when queued
   };
-  void queue_request(const std::string &cmd, const std::string &param, const std::function<void(rpn::WordDefinition::Result res)> &completionHandler) {
+  void queue_request(const std::string &cmd, const std::string &param, const std::function<void(rpn::WordDefinition::Result res)> &completionHandler, rpn::Interp::Priority prio) {
+    std::lock_guard lg(_qmx);
+    auto run = new_run(prio);
+    _lanes[run->lane].push_back({cmd, param, completionHandler, run});
+    _qcv.notify_one();
+  }
+  // a batch takes the lock and wakes the loop once
+  void queue_requests(std::vector<Request> &&reqs, rpn::Interp::Priority prio) {
     std::lock_guard lg(_qmx);
-    _queue.push({cmd, param, completionHandler});
+    for(auto &req : reqs) {
+      req.run = new_run(prio);
+      _lanes[req.run->lane].push_back(std::move(req));
+    }
     _qcv.notify_one();
   }
+  // with _qmx held
+  std::shared_ptr<Run> new_run(rpn::Interp::Priority prio) {
+    auto rv = std::make_shared<Run>();
+    rv->id = ++_lastId;
+    rv->lane = (prio == rpn::Interp::Priority::interactive) ? 0 : 1;
+    rv->queued = std::chrono::steady_clock::now();
+    rv->budget = _budget;
+    if (rv->lane == 0) {
+      _urgent++;
+    }
+    return rv;
+  }
+  void set_budget(const rpn::Interp::Budget &b) {
+    std::lock_guard lg(_qmx);
+    _budget = b;
+  }
+  void cancel() {
+    uint64_t id = _runId;
+    if (id) {
+      _cancelId = id;
+    }
+  }
+  // anything queued behind the running request
+  bool waiting() {
+    std::lock_guard lg(_qmx);
+    return _batchLeft > 1 || !_lanes[0].empty() || !_lanes[1].empty();
+  }
+
+  void record(Run &run, std::chrono::microseconds rpn::Interp::LaneStats::*total,
+	      std::chrono::microseconds rpn::Interp::LaneStats::*worst) {
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - run.queued);
+    std::lock_guard lg(_qmx);
+    auto &st = _stats[run.lane];
+    st.*total += us;
+    st.*worst = std::max(st.*worst, us);
+  }
+  rpn::Interp::LaneStats lane_stats(rpn::Interp::Priority prio) {
+    std::lock_guard lg(_qmx);
+    return _stats[(prio == rpn::Interp::Priority::interactive) ? 0 : 1];
+  }
 
-  std::queue<Request> _queue;
+  // interactive lane first, the bulk one gets a turn after this many
+  // interactive requests in a row
+  static constexpr unsigned starve_limit = 8;
+  std::deque<Request> _lanes[2];
+  std::atomic<size_t> _urgent {0}; // interactive requests not yet taken
+  rpn::Interp::LaneStats _stats[2];
+  size_t _batchLeft = 0; // of the batch main_loop is running, with the running request
   bool _running;
   void main_loop() {
     _running = true;
+    std::deque<Request> batch;
+    unsigned served = 0; // interactive requests since the last bulk one
     for(;_running;) {
 
-      std::unique_lock ul(_qmx);
-      _qcv.wait(ul, [this]{return !_queue.empty() || !_running;});
+      // take a lane's worth, submitters aren't held up while it runs
+      size_t lane;
+      {
+	std::unique_lock ul(_qmx);
+	_qcv.wait(ul, [this]{return !_lanes[0].empty() || !_lanes[1].empty() || !_running;});
+	if (_lanes[1].empty()) {
+	  served = 0;
+	}
+	lane = (_lanes[0].empty() || (!_lanes[1].empty() && served >= starve_limit)) ? 1 : 0;
+	std::swap(batch, _lanes[lane]);
+	if (lane == 0) {
+	  _urgent = 0;
+	} else {
+	  served = 0;
+	}
+      }
 
-      if (_running) {
-	auto req = _queue.front();
-	_queue.pop();
+      for(bool first = true; _running && !batch.empty(); batch.pop_front(), first = false) {
+	if (lane == 1 && !first && _urgent.load(std::memory_order_relaxed)) {
+	  // the rest of the bulk batch waits at the head of its lane
+	  std::lock_guard lg(_qmx);
+	  _lanes[1].insert(_lanes[1].begin(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+	  batch.clear();
+	  break;
+	}
+	Request &req = batch.front();
+	{
+	  std::lock_guard lg(_qmx);
+	  _batchLeft = batch.size();
+	}
+	if (!req.run->started) {
+	  req.run->started = true;
+	  record(*req.run, &rpn::Interp::LaneStats::wait, &rpn::Interp::LaneStats::wait_max);
+	}
+	if (lane == 0) {
+	  served++;
+	}
 
+	rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::dict_error;
+	bool done = true;
+	auto started = std::chrono::steady_clock::now();
+	start_slice(*req.run);
 	if(req.cmd=="eval") {
-	  req.completionHandler(parse(req.param));
+	  rv = parse(req.param);
 	} else if (req.cmd == "parseFile") {
-	  req.completionHandler(sync_parse_file(req.param));
+	  done = sync_parse_file(req.param, *req.run, rv);
+	} else if (req.cmd == "reloadFile") {
+	  rv = sync_reload_file(req.param);
+	} else if (req.cmd == "saveStack") {
+	  rv = sync_save_stack(req.param);
+	} else if (req.cmd == "restoreStack") {
+	  rv = sync_restore_stack(req.param);
+	}
+	end_slice(*req.run, started);
+	finish(rv);
+	_rpn.stack.checkpoint(); // one undo level per request, or slice of a file
+	_rpn.stack.publish(_status); // observers see the stack as of request completion
+	if (done) {
+	  record(*req.run, &rpn::Interp::LaneStats::latency, &rpn::Interp::LaneStats::latency_max);
+	  {
+	    std::lock_guard lg(_qmx);
+	    _stats[req.run->lane].requests++;
+	  }
+	  req.completionHandler(rv);
+	} else {
+	  // the rest of the file after whatever is queued in its lane now
+	  std::lock_guard lg(_qmx);
+	  _lanes[req.run->lane].push_back(std::move(req));
 	}
       }
     }
   }
 };
 
+Progn::Progn(rpn::Interp::Privates &p, CompileType t) : _p(p), _type(t) {
+  _locals = std::make_shared<var_dict_t>();
+  _bytes = sizeof(Progn);
+  _p._progns++;
+  _p._prognBytes += _bytes;
+}
+
+Progn::~Progn() {
+  _p._progns--;
+  _p._prognBytes -= _bytes;
+}
+
+void
+Progn::account() {
+  size_t bytes = sizeof(Progn) + _ctl.capacity() * sizeof(Ctl) + _locals->size() * sizeof(var_dict_t::value_type);
+  for(auto const &w : _wordlist) {
+    bytes += sizeof(w) + ((w.capacity() > 15) ? w.capacity() : 0);
+  }
+  _p._prognBytes += bytes;
+  _p._prognBytes -= _bytes;
+  _bytes = bytes;
+}
+
+uint64_t
+Progn::stamp() const {
+  return (_tracked) ? _epoch : _p._generation;
+}
+
+void
+Progn::restamp(uint64_t epoch) {
+  _tracked = true;
+  _epoch = epoch;
+  for(auto &n : _nested) {
+    if (n->_type != ct_mathexpr) { // shared with the EVAL cache, follows every change
+      n->restamp(epoch);
+    }
+  }
+}
+
+void
+Progn::uses(std::set<std::string> &words) const {
+  for(size_t pc=0; pc<_wordlist.size(); pc++) {
+    if (_ctl[pc].op != Ctl::word) {
+      continue;
+    }
+    if (_wordlist[pc] == ".\"") {
+      pc++; // the literal
+      continue;
+    }
+    words.insert(_wordlist[pc]);
+  }
+  for(auto const &n : _nested) {
+    if (n->_type != ct_mathexpr) {
+      n->uses(words);
+    }
+  }
+}
+
 rpn::WordDefinition::Result
 Progn::eval_forloop(rpn::Interp &rpn) {
   rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
   double end = rpn.stack.pop_as_double();
   double start = rpn.stack.pop_as_double();
+  if (_parallel && eval_parfor(rpn, start, end, rv)) {
+    return rv;
+  }
   _p._vlocals.push_back(_locals);
+  auto body = code();
+  std::vector<double> v;
+  if (body->loop && start < end && !start_loop(rpn, *body->loop, start, end, v)) {
+    body = body->plain; // the invariants aren't all numbers, run it as written
+  }
   for(; rv==rpn::WordDefinition::Result::ok && start<end; start += 1) {
     (*_locals)[_ident] = std::make_unique<StDouble>(StDouble(start));
-    rv = eval_lambda(rpn);
+    if (body->loop) {
+      step_loop(*body->loop, start, v);
+    }
+    rv = eval_lambda(rpn, body);
   }
   _p._vlocals.pop_back();
   return rv;
@@ -248,198 +958,1713 @@ Progn::eval_forloop(rpn::Interp &rpn) {
 
 rpn::WordDefinition::Result
 Progn::eval_whileloop(rpn::Interp &rpn) {
-  rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
-  return rv;
+  // the loop is a backward jump in the body, one frame for all the iterations
+  return eval_lambda(rpn);
 }
 
 rpn::WordDefinition::Result
-Progn::eval_lambda(rpn::Interp &rpn) {
+Progn::eval_lambda(rpn::Interp &rpn, std::shared_ptr<const Code> run) {
   rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
   std::string rest;
 
+  // compiled words called from here run in this loop with their return
+  // address on _p._rstack, a call in tail position replaces the caller's frame
+  auto &rstack = _p._rstack;
+  size_t base = rstack.size();
+  size_t floor = _p._vlocalsFloor;
+  size_t vbase = _p._vlocals.size();
+  auto unwind = [&]() {
+    // the frames and locals an error (or a throw) left behind
+    rstack.erase(rstack.begin()+base, rstack.end());
+    _p._vlocals.erase(_p._vlocals.begin()+vbase, _p._vlocals.end());
+    _p._vlocalsFloor = floor;
+  };
   _p._vlocals.push_back(_locals);
+  auto entry = (run) ? run : code();
+  rstack.push_back({ shared_from_this(), entry, 0, binding(rpn, *entry), floor });
+
+  Progn *pg = this;
+  const Code *cd = entry.get();
+  const Binding *bound = rstack.back().bound.get();
+  size_t pc = 0;
+
+  try {
+    while (rv==rpn::WordDefinition::Result::ok) {
+      if (_p.stopping()) {
+	rv = rpn::WordDefinition::Result::cancelled;
+	break;
+      }
+      if (pc >= cd->wordlist.size()) {
+	// return to the caller
+	_p._vlocals.pop_back();
+	rstack.pop_back();
+	if (rstack.size() == base) {
+	  break;
+	}
+	pg = rstack.back().progn.get();
+	cd = rstack.back().code.get();
+	pc = rstack.back().pc;
+	bound = rstack.back().bound.get();
+	_p._vlocalsFloor = rstack.back().floor;
+	continue;
+      }
 
-  for(auto wi= _wordlist.cbegin(); rv==rpn::WordDefinition::Result::ok && wi != _wordlist.cend(); wi++) {
-    var_dict_t::const_iterator lv = _locals->find(*wi);
-    bool lvp = (lv != _locals->end());
-    if (!lvp) {
-      lvp = _p.find_local_variable(lv, *wi);
-    }
+      size_t at = pc++;
+      auto wi = cd->wordlist.cbegin() + at;
+      const Ctl &ctl = cd->ctl[at];
+      if (ctl.op == Ctl::nested) {
+	Progn *pn = pg->_nested[ctl.target].get();
+	if (_p._tracing) {
+	  rpn.stack.print("nested progn");
+	  pn->print();
+	}
+	rv = pn->eval(rpn);
+	continue;
+      }
+      if (ctl.op != Ctl::word) {
+	bool jump = true;
+	if (ctl.op == Ctl::branch0 || ctl.op == Ctl::of) {
+	  if (rpn.stack.depth() < ((ctl.op == Ctl::of) ? 2 : 1)) {
+	    printf("%s: stack underflow\n", wi->c_str());
+	    rv = rpn::WordDefinition::Result::param_error;
+	    break;
+	  }
+	  if (ctl.op == Ctl::branch0) {
+	    jump = !rpn.stack.pop_as_boolean();
+	  } else {
+	    auto val = rpn.stack.pop();
+	    // operator== only compares like types, anything else is no match
+	    const auto &sel = rpn.stack.peek(1);
+	    jump = !(sel.type_id() == val->type_id() && sel == *val);
+	    if (!jump) {
+	      rpn.stack.drop(); // the selector
+	    }
+	  }
+	}
+	if (jump) {
+	  pc = ctl.target;
+	}
+	continue;
+      }
 
-    if (lvp) {
-      auto *pn = dynamic_cast<Progn*>(&(*lv->second));
-      if (pn != nullptr) {
-	rpn.stack.print("recursive progn");
-	pn->print();
-	pn->eval(rpn);
+      const Site *site = (bound && bound->sites[at].known) ? &bound->sites[at] : nullptr;
+      if (*wi == ".\"" && (wi+1) != cd->wordlist.cend()) {
+	// ct_DQUOTE compiles string literals as two words
+	rpn.stack.push_string(cd->wordlist[pc++]);
+	continue;
+      }
 
-      } else {
-	std::string sv = (*lv->second);
-	printf("push local: %s => %s\n", lv->first.c_str(), sv.c_str());
+      var_dict_t::const_iterator lv = pg->_locals->find(*wi);
+      bool lvp = (lv != pg->_locals->end());
+      if (!lvp) {
+	lvp = _p.find_local_variable(lv, *wi);
+      }
+
+      if (site && site->local != lvp) {
+	bound = nullptr; // scoped differently than when it was inferred
+	site = nullptr;
+      }
+
+      if (lvp) {
+	if (_p._tracing) {
+	  std::string sv = (*lv->second);
+	  printf("push local: %s => %s\n", lv->first.c_str(), sv.c_str());
+	}
 	rpn.stack.push(*lv->second);
 
+      } else {
+	const rpn::WordDefinition *def = (site && site->def) ? site->def : _p.resolve(*wi);
+	Progn *callee = (def) ? dynamic_cast<Progn*>(def->context) : nullptr;
+	if (callee && callee->_type == ct_worddef) {
+	  if (callee->_native && callee->_native->run(rpn.stack)) {
+	    continue;
+	  }
+	  // skip the jumps to the end, nothing is left to do here after a tail call
+	  size_t next = pc;
+	  while (next < cd->ctl.size() && cd->ctl[next].op == Ctl::branch) {
+	    next = cd->ctl[next].target;
+	  }
+	  if (next < cd->wordlist.size()) {
+	    rstack.back().pc = pc;
+	  } else {
+	    _p._vlocals.pop_back();
+	    rstack.pop_back();
+	  }
+	  _p._vlocalsFloor = _p._vlocals.size();
+	  _p._vlocals.push_back(callee->_locals);
+	  auto cc = callee->code();
+	  rstack.push_back({ callee->shared_from_this(), cc, 0, callee->binding(rpn, *cc), _p._vlocalsFloor });
+	  pg = callee;
+	  cd = cc.get();
+	  pc = 0;
+	  bound = rstack.back().bound.get();
+
+	} else {
+	  rv = _p.eval(*wi, rest, def);
+
+	}
       }
+    }
+  } catch (...) {
+    unwind(); // Privates::eval reports it
+    throw;
+  }
 
+  unwind();
+  return rv;
+}
+
+// the stack shuffles, applied to whatever stands for the stack items (types,
+// values, ...); the count of the n-words is on top of st, k is its value
+enum class Shuffle { none, underflow, ok };
+
+template<typename T>
+static Shuffle
+shuffle(const std::string &word, std::vector<T> &st, int64_t k) {
+  size_t n = st.size();
+  if (word == "DROP") {
+    if (n<1) return Shuffle::underflow;
+    st.pop_back();
+  } else if (word == "DUP") {
+    if (n<1) return Shuffle::underflow;
+    st.push_back(st[n-1]);
+  } else if (word == "OVER") {
+    if (n<2) return Shuffle::underflow;
+    st.push_back(st[n-2]);
+  } else if (word == "SWAP") {
+    if (n<2) return Shuffle::underflow;
+    std::swap(st[n-1], st[n-2]);
+  } else if (word == "ROTU" || word == "ROTD") {
+    if (n<3) return Shuffle::underflow;
+    if (word == "ROTU") {
+      std::rotate(st.end()-3, st.end()-2, st.end());
+    } else {
+      std::rotate(st.end()-3, st.end()-1, st.end());
+    }
+  } else if (word == "PICK" || word == "DROPn" || word == "DUPn" || word == "NIPn" ||
+	     word == "ROLLDn" || word == "ROLLUn" || word == "TUCKn" || word == "REVERSEn") {
+    if (k <= 0) return Shuffle::none;
+    if (n < 1 || (size_t)k > n-1) return Shuffle::underflow;
+    st.pop_back();
+    if (word == "PICK") {
+      st.push_back(st[st.size()-k]);
+    } else if (word == "DROPn") {
+      st.resize(st.size()-k);
+    } else if (word == "DUPn") {
+      std::vector<T> top(st.end()-k, st.end());
+      st.insert(st.end(), top.cbegin(), top.cend());
+    } else if (word == "NIPn") {
+      st.erase(st.end()-k);
+    } else if (word == "ROLLDn") {
+      std::rotate(st.end()-k, st.end()-1, st.end());
+    } else if (word == "ROLLUn") {
+      std::rotate(st.end()-k, st.end()-k+1, st.end());
+    } else if (word == "TUCKn") {
+      st.insert(st.end()-(k-1), st.back());
     } else {
-      rv = _p.eval(*wi, rest);
+      std::reverse(st.end()-k, st.end());
+    }
+  } else {
+    return Shuffle::none;
+  }
+  return Shuffle::ok;
+}
+
+// what a built-in word does to the types on the stack, false if it isn't known
+static bool
+stack_effect(const std::string &word, std::vector<rpn::TypeId> &st, int64_t k) {
+  const rpn::TypeId t_int = rpn::Types::t_integer;
+  const rpn::TypeId t_double = rpn::Types::t_double;
+  const rpn::TypeId t_bool = rpn::Types::t_boolean;
+  static const std::set<std::string> arith2 = { "+", "-", "*", "/", "^", "MIN", "MAX" };
+  static const std::set<std::string> double2 = { "HYPOT", "ATAN2" };
+  static const std::set<std::string> same1 = { "SQ", "CHS" };
+  static const std::set<std::string> double1 = { "INV", "SQRT", "COS", "SIN", "TAN", "ACOS", "ASIN", "ATAN",
+						 "EXP", "LN", "LN2", "LOG", "ROUND", "CEIL", "FLOOR" };
+  static const std::set<std::string> double0 = { "k_PI", "k_E", "RAND", "DRAND" };
+  static const std::set<std::string> compare = { "==", "!=", "<", ">", "<=", ">=" };
+  static const std::set<std::string> same2 = { "AND", "OR", "XOR" };
+
+  auto number = [](rpn::TypeId t) { return t == t_int || t == t_double; };
+  size_t n = st.size(); // k is tos as an integer constant, -1 if not known
+
+  if (arith2.count(word) || double2.count(word)) {
+    if (n<2 || !number(st[n-1]) || !number(st[n-2])) return false;
+    bool integers = (st[n-1] == t_int && st[n-2] == t_int && arith2.count(word));
+    st.resize(n-2);
+    st.push_back(integers ? t_int : t_double);
+  } else if (same1.count(word) || double1.count(word)) {
+    if (n<1 || !number(st[n-1])) return false;
+    if (double1.count(word)) st[n-1] = t_double;
+  } else if (double0.count(word)) {
+    st.push_back(t_double);
+  } else if (compare.count(word)) {
+    if (n<2) return false;
+    st.resize(n-2);
+    st.push_back(t_bool);
+  } else if (same2.count(word)) {
+    if (n<2) return false;
+    st.resize(n-1);
+  } else if (word == "NOT" || word == "NEG") {
+    if (n<1) return false;
+  } else if (word == "DEPTH") {
+    st.push_back(t_int);
+  } else if (word == ".S") {
+    // no change
+  } else {
+    return shuffle(word, st, k) == Shuffle::ok;
+  }
+  return true;
+}
+
+namespace {
+  // inferred types at one pc: 'st' sits on top of the first 'base' entry items
+  // (those were read), back is the top; k is tos as an integer literal or -1
+  struct AbsState {
+    bool set;
+    size_t base;
+    std::vector<rpn::TypeId> st;
+    int64_t k;
+  };
+}
+
+std::shared_ptr<const Progn::Binding>
+Progn::infer(rpn::Interp &rpn, const Code &code) {
+  auto b = std::make_shared<Binding>();
+  b->generation = stamp();
+  b->code = &code;
+  b->sites.resize(code.wordlist.size(), Site { nullptr, false, false });
+
+  const size_t n = code.wordlist.size();
+  const size_t depth = rpn.stack.depth();
+  std::vector<AbsState> at(n+1, AbsState { false, 0, {}, -1 });
+  std::vector<bool> poison(n+1, false); // types unknown from here on
+  std::vector<size_t> work;
+
+  // pull entry items under s until it holds k values
+  auto need = [&](AbsState &s, size_t k) {
+    while(s.st.size() < k) {
+      if (s.base == b->entry.size()) {
+	if (b->entry.size() >= depth) {
+	  return false;
+	}
+	auto &ob = rpn.stack.peek((int)b->entry.size()+1);
+	b->entry.push_back(ob.type_id());
+      }
+      s.st.insert(s.st.begin(), b->entry[s.base]);
+      s.base++;
+    }
+    return true;
+  };
+
+  // s flows into pc; a join that disagrees on types is not followed
+  auto flow = [&](size_t pc, AbsState s) {
+    AbsState &t = at[pc];
+    if (!t.set) {
+      t = std::move(s);
+      t.set = true;
+      work.push_back(pc);
+      return;
+    }
+    while(t.base < s.base) need(t, t.st.size()+1);
+    while(s.base < t.base) need(s, s.st.size()+1);
+    if (t.st != s.st || t.k != s.k) {
+      poison[pc] = true;
+    }
+  };
+
+  size_t nbound = 0;
+  flow(0, AbsState { true, 0, {}, -1 });
+  while(!work.empty()) {
+    size_t pc = work.back();
+    work.pop_back();
+    if (pc == n || poison[pc]) {
+      continue;
+    }
+
+    AbsState s = at[pc];
+    int64_t k = s.k;
+    s.k = -1;
+    const std::string &word = code.wordlist[pc];
+    const Ctl &ctl = code.ctl[pc];
+
+    if (ctl.op == Ctl::nested) {
+      poison[pc] = true; // its effect isn't known
+      continue;
+    }
+    if (ctl.op != Ctl::word) {
+      b->sites[pc].known = true;
+      if (ctl.op == Ctl::branch) {
+	flow(ctl.target, s);
+      } else if (!need(s, (ctl.op == Ctl::of) ? 2 : 1)) {
+	poison[pc] = true;
+      } else {
+	s.st.pop_back();
+	if (ctl.op == Ctl::of) {
+	  flow(ctl.target, s); // keeps the selector
+	  s.st.pop_back();
+	} else {
+	  flow(ctl.target, s);
+	}
+	flow(pc+1, s);
+      }
+      continue;
+    }
+
+    if (word == ".\"" && pc+1 < n) {
+      b->sites[pc].known = true;
+      s.st.push_back(rpn::Types::t_string);
+      flow(pc+2, s);
+      continue;
+    }
 
+    var_dict_t::const_iterator lv = _locals->find(word);
+    bool lvp = (lv != _locals->end());
+    if (!lvp) {
+      lvp = _p.find_local_variable(lv, word);
+    }
+    if (lvp) {
+      auto &ob = *lv->second;
+      b->locals.emplace_back(word, ob.type_id());
+      b->sites[pc].local = true;
+      b->sites[pc].known = true;
+      s.st.push_back(b->locals.back().second);
+      flow(pc+1, s);
+      continue;
+    }
+
+    if (std::isdigit(word[0])||(word[0]=='-'&&std::isdigit(word[1]))) {
+      b->sites[pc].known = true;
+      if (word.find('.') != std::string::npos) {
+	s.st.push_back(rpn::Types::t_double);
+      } else {
+	long val = strtol(word.c_str(), nullptr, 0);
+	s.st.push_back(rpn::Types::t_integer);
+	s.k = (val > 0) ? val : -1;
+      }
+      flow(pc+1, s);
+      continue;
+    }
+
+    // the first definition that is proven to accept, as validate_word would find it
+    const rpn::WordDefinition *def = nullptr;
+    bool proven = true;
+    const auto end = _p._rtDictionary.upper_bound(word);
+    for(auto we = _p._rtDictionary.lower_bound(word); proven && def==nullptr && we!=end; ) {
+      std::vector<rpn::TypeId> known(s.st.rbegin(), s.st.rend());
+      const int64_t *tos = (k > 0) ? &k : nullptr;
+      switch(we->second.validator.prove(known, tos)) {
+      case rpn::StackValidator::Proof::accept:
+	def = &we->second;
+	break;
+      case rpn::StackValidator::Proof::reject:
+	we++;
+	break;
+      case rpn::StackValidator::Proof::deeper:
+	proven = need(s, s.st.size()+1);
+	break;
+      case rpn::StackValidator::Proof::unknown:
+	proven = false;
+	break;
+      }
+    }
+    if (def == nullptr) {
+      poison[pc] = true;
+      continue;
+    }
+    b->sites[pc] = Site { def, false, true };
+    nbound++;
+
+    // only the built-ins have known effects
+    if (def->context != nullptr || !stack_effect(word, s.st, k)) {
+      poison[pc+1] = true;
+      continue;
+    }
+    flow(pc+1, s);
+  }
+
+  // everything reachable from where the types were lost is checked at runtime
+  std::vector<size_t> lost;
+  for(size_t pc=0; pc<n; pc++) {
+    if (poison[pc]) lost.push_back(pc);
+  }
+  std::vector<bool> seen(n+1, false);
+  while(!lost.empty()) {
+    size_t pc = lost.back();
+    lost.pop_back();
+    if (pc >= n || seen[pc]) {
+      continue;
+    }
+    seen[pc] = true;
+    if (b->sites[pc].def) {
+      nbound--;
+    }
+    b->sites[pc] = Site { nullptr, false, false };
+    if (code.ctl[pc].jumps()) {
+      lost.push_back(code.ctl[pc].target);
+    }
+    if (code.ctl[pc].op != Ctl::branch) {
+      lost.push_back(pc+1);
+    }
+  }
+
+  if (_p._tracing) {
+    printf("bound %zu of %zu words (%zu entry types)\n", nbound, code.wordlist.size(), b->entry.size());
+  }
+  return b;
+}
+
+std::shared_ptr<const Progn::Binding>
+Progn::binding(rpn::Interp &rpn, const Code &code) {
+  size_t depth = rpn.stack.depth();
+  for(auto bi=_bindings.begin(); bi!=_bindings.end(); ) {
+    const Binding &b = **bi;
+    if (b.generation != stamp()) {
+      bi = _bindings.erase(bi);
+      continue;
+    }
+    bool match = (b.code == &code && depth >= b.entry.size());
+    for(size_t i=0; match && i<b.entry.size(); i++) {
+      match = (rpn.stack.type((int)i+1) == b.entry[i]);
+    }
+    for(auto li=b.locals.cbegin(); match && li!=b.locals.cend(); li++) {
+      var_dict_t::const_iterator lv = _locals->find(li->first);
+      bool lvp = (lv != _locals->end());
+      if (!lvp) {
+	lvp = _p.find_local_variable(lv, li->first);
+      }
+      match = lvp && (lv->second->type_id() == li->second);
+    }
+    if (match) {
+      return *bi;
+    }
+    bi++;
+  }
+
+  if (_bindings.size() >= 4) {
+    return nullptr; // too many shapes, just validate
+  }
+  _bindings.push_back(infer(rpn, code));
+  return _bindings.back();
+}
+
+// a compiled word that can be spliced in place of a call to it: small,
+// one definition, no loops of its own and nothing that a local here would capture
+Progn *
+Progn::inlineable(const std::string &word) {
+  static const size_t max_words = 8;
+  if (_type == ct_mathexpr || // its names are resolved wherever it is evaluated
+      std::isdigit(word[0])||(word[0]=='-'&&std::isdigit(word[1])) ||
+      std::find(_scope.cbegin(), _scope.cend(), word) != _scope.cend()) {
+    return nullptr;
+  }
+  auto range = _p._rtDictionary.equal_range(word);
+  if (range.first == range.second || std::next(range.first) != range.second) {
+    return nullptr;
+  }
+  Progn *callee = dynamic_cast<Progn*>(range.first->second.context);
+  if (callee == nullptr || callee == this || callee->_type != ct_worddef || callee->_expanding ||
+      callee->_native || callee->_nested.size() > 0) {
+    return nullptr;
+  }
+  auto cc = callee->code();
+  if (cc->wordlist.size() > max_words) {
+    return nullptr;
+  }
+  for(const auto &w : cc->wordlist) {
+    if (std::find(_scope.cbegin(), _scope.cend(), w) != _scope.cend()) {
+      return nullptr;
+    }
+  }
+  return callee;
+}
+
+std::shared_ptr<const Progn::Code>
+Progn::code() {
+  if (_code && _code->generation == stamp()) {
+    return _code;
+  }
+
+  auto c = std::make_shared<Code>();
+  c->generation = stamp();
+  std::vector<uint32_t> moved(_wordlist.size()+1); // jump targets, from _wordlist to c
+  std::vector<size_t> jumps;
+  size_t inlined = 0;
+
+  _expanding = true;
+  for(size_t pc=0; pc<_wordlist.size(); pc++) {
+    moved[pc] = (uint32_t)c->ctl.size();
+    if (_ctl[pc].op == Ctl::nested && unroll(pc, *c)) {
+      continue;
+    }
+    Progn *callee = (_ctl[pc].op == Ctl::word && _wordlist[pc] != ".\"") ? inlineable(_wordlist[pc]) : nullptr;
+    if (callee) {
+      auto cc = callee->code();
+      uint32_t offset = (uint32_t)c->ctl.size();
+      for(size_t i=0; i<cc->ctl.size(); i++) {
+	Ctl ctl = cc->ctl[i];
+	if (ctl.jumps()) {
+	  ctl.target += offset;
+	}
+	c->wordlist.push_back(cc->wordlist[i]);
+	c->ctl.push_back(ctl);
+      }
+      inlined++;
+      continue;
+    }
+
+    c->wordlist.push_back(_wordlist[pc]);
+    c->ctl.push_back(_ctl[pc]);
+    if (_ctl[pc].jumps()) {
+      jumps.push_back(c->ctl.size()-1);
+    }
+    if (_wordlist[pc] == ".\"" && pc+1 < _wordlist.size()) {
+      // the literal is never a word
+      pc++;
+      moved[pc] = (uint32_t)c->ctl.size();
+      c->wordlist.push_back(_wordlist[pc]);
+      c->ctl.push_back(_ctl[pc]);
+    }
+  }
+  _expanding = false;
+  moved[_wordlist.size()] = (uint32_t)c->ctl.size();
+  for(auto j : jumps) {
+    c->ctl[j].target = moved[c->ctl[j].target];
+  }
+
+  if (_p._tracing && inlined > 0) {
+    printf("'%s': %zu calls inlined\n", _ident.c_str(), inlined);
+  }
+
+  if (_type == ct_forloop) {
+    auto out = std::make_shared<Code>();
+    out->loop = plan_loop(*c, *out);
+    if (out->loop) {
+      out->plain = c;
+      c = out;
+    }
+  }
+
+  _code = c;
+  return _code;
+}
+
+// "a b FOR i ... NEXT" with literal bounds and a few iterations of a small
+// body is replaced by the body copies, with i as a literal in each
+bool
+Progn::unroll(size_t pc, Code &c) {
+  static const size_t max_trips = 16;
+  static const size_t max_words = 64;
+  auto integer = [this](size_t at) {
+    const std::string &w = _wordlist[at];
+    return (_ctl[at].op == Ctl::word && (at == 0 || _wordlist[at-1] != ".\"") &&
+	    (std::isdigit(w[0])||(w[0]=='-'&&std::isdigit(w[1]))) &&
+	    w.find_first_of(".eE") == std::string::npos);
+  };
+
+  Progn *loop = _nested[_ctl[pc].target].get();
+  if (loop->_type != ct_forloop || loop->_nested.size() > 0 || pc < 2 || !integer(pc-2) || !integer(pc-1) ||
+      c.wordlist.size() < 2 || c.wordlist.back() != _wordlist[pc-1]) {
+    return false;
+  }
+  for(const auto &ctl : _ctl) {
+    if (ctl.jumps() && (ctl.target == pc-1 || ctl.target == pc)) {
+      return false;
+    }
+  }
+  int64_t start = strtol(_wordlist[pc-2].c_str(), nullptr, 0);
+  int64_t end = strtol(_wordlist[pc-1].c_str(), nullptr, 0);
+  size_t trips = (end > start) ? (size_t)(end-start) : 0;
+  auto body = loop->code();
+  if (body->plain) {
+    body = body->plain;
+  }
+  if (trips > max_trips || trips*body->wordlist.size() > max_words) {
+    return false;
+  }
+
+  c.wordlist.resize(c.wordlist.size()-2);
+  c.ctl.resize(c.ctl.size()-2);
+  for(int64_t i=start; i<end; i++) {
+    std::string index = std::to_string((double)i); // with a '.', so it is pushed as a double like i
+    uint32_t offset = (uint32_t)c.ctl.size();
+    for(size_t at=0; at<body->wordlist.size(); at++) {
+      Ctl ctl = body->ctl[at];
+      if (ctl.jumps()) {
+	ctl.target += offset;
+      }
+      bool literal = (at > 0 && body->wordlist[at-1] == ".\"");
+      c.wordlist.push_back((!literal && body->wordlist[at] == loop->_ident) ? index : body->wordlist[at]);
+      c.ctl.push_back(ctl);
+    }
+  }
+  if (_p._tracing) {
+    printf("'%s': FOR %s unrolled %zu times\n", _ident.c_str(), loop->_ident.c_str(), trips);
+  }
+  return true;
+}
+
+/*
+ * Symbolic evaluation of a straight FOR body.  Entry stack items that are
+ * back in their place at the end of the body hold the same value in
+ * every iteration, so do pure expressions of them and of constants (and
+ * of enclosing loop variables); those are hoisted.  Expressions built
+ * with + - * / from hoisted values and the loop variable are computed
+ * natively, a multiplication of the loop variable by a hoisted value
+ * becomes an addition per iteration.  Only the spans of words that
+ * compute such a value on their own are replaced.
+ */
+std::shared_ptr<const Progn::LoopPlan>
+Progn::plan_loop(const Code &in, Code &out) {
+  static const std::set<std::string> pure2 = { "+", "-", "*", "/", "^", "MIN", "MAX", "HYPOT", "ATAN2" };
+  static const std::set<std::string> pure1 = { "SQ", "CHS", "INV", "SQRT", "COS", "SIN", "TAN", "ACOS", "ASIN", "ATAN",
+					       "EXP", "LN", "LN2", "LOG", "ROUND", "CEIL", "FLOOR",
+					       "->VEC3x", "->VEC3y", "->VEC3z" };
+  static const std::set<std::string> affine = { "+", "-", "*", "/" };
+  static const size_t max_entries = 32;
+
+  struct Node {
+    enum Kind : uint8_t { entry, index, outer, constant, unary, binary } kind;
+    std::string word;
+    int a, b; // operands, or the entry item for entry
+  };
+  std::vector<Node> nodes;
+  std::map<std::tuple<int,std::string,int,int>,int> interned;
+  auto node = [&](Node::Kind kind, const std::string &word, int a=-1, int b=-1) {
+    auto key = std::make_tuple((int)kind, word, a, b);
+    auto ni = interned.find(key);
+    if (ni != interned.end()) {
+      return ni->second;
+    }
+    nodes.push_back({ kind, word, a, b });
+    return interned[key] = (int)nodes.size()-1;
+  };
+
+  // a value made by the words [b,e] alone, absorbed when its parent's words include them
+  struct Made {
+    int node;
+    size_t b, e;
+    bool op;
+    int parent;
+  };
+  std::vector<Made> made;
+  struct Val {
+    int node;
+    int made; // -1 if it isn't the value of a span of words
+  };
+  std::vector<Val> st;
+  std::vector<int> entries;
+  auto pull = [&](size_t k) {
+    while(st.size() < k) {
+      if (entries.size() >= max_entries) {
+	return false;
+      }
+      entries.push_back(node(Node::entry, "", (int)entries.size()));
+      st.insert(st.begin(), Val { entries.back(), -1 });
+    }
+    return true;
+  };
+  auto push = [&](int n, size_t b, size_t e, bool op) {
+    made.push_back({ n, b, e, op, -1 });
+    st.push_back({ n, (int)made.size()-1 });
+  };
+  // the words of v end right before at
+  auto adjacent = [&](const Val &v, size_t at) { return v.made >= 0 && made[v.made].e+1 == at; };
+  auto number = [](const std::string &w) { return (std::isdigit(w[0])||(w[0]=='-'&&std::isdigit(w[1]))); };
+  auto builtin = [this](const std::string &word) {
+    auto range = _p._rtDictionary.equal_range(word);
+    for(auto we=range.first; we!=range.second; we++) {
+      if (dynamic_cast<Progn*>(we->second.context) != nullptr) {
+	return false;
+      }
+    }
+    return (range.first != range.second);
+  };
+  auto count = [&]() -> int64_t {
+    if (st.size() > 0 && nodes[st.back().node].kind == Node::constant &&
+	nodes[st.back().node].word.find_first_of(".eE") == std::string::npos) {
+      return strtol(nodes[st.back().node].word.c_str(), nullptr, 0);
+    }
+    return -1;
+  };
+
+  for(size_t pc=0; pc<in.wordlist.size(); pc++) {
+    const std::string &w = in.wordlist[pc];
+    if (in.ctl[pc].op != Ctl::word || w == ".\"") {
+      return nullptr;
+    }
+    if (number(w)) {
+      push(node(Node::constant, w), pc, pc, false);
+    } else if (w == _ident) {
+      push(node(Node::index, w), pc, pc, false);
+    } else if (std::find(_scope.cbegin(), _scope.cend(), w) != _scope.cend()) {
+      push(node(Node::outer, w), pc, pc, false);
+    } else if (!builtin(w)) {
+      return nullptr;
+    } else if (pure2.count(w)) {
+      if (!pull(2)) return nullptr;
+      Val y = st.back(); st.pop_back();
+      Val x = st.back(); st.pop_back();
+      int n = node(Node::binary, w, x.node, y.node);
+      if (adjacent(y, pc) && adjacent(x, made[y.made].b)) {
+	push(n, made[x.made].b, pc, true);
+	made[x.made].parent = made[y.made].parent = (int)made.size()-1;
+      } else {
+	st.push_back({ n, -1 });
+      }
+    } else if (pure1.count(w)) {
+      if (!pull(1)) return nullptr;
+      Val x = st.back(); st.pop_back();
+      int n = node(Node::unary, w, x.node);
+      if (adjacent(x, pc)) {
+	push(n, made[x.made].b, pc, true);
+	made[x.made].parent = (int)made.size()-1;
+      } else {
+	st.push_back({ n, -1 });
+      }
+    } else if (w == "DUP" || w == "OVER" || (w == "PICK" && count() > 0 && adjacent(st.back(), pc))) {
+      // copies are values of these words alone
+      size_t k = (w == "DUP") ? 1 : (w == "OVER") ? 2 : (size_t)count();
+      size_t b = pc;
+      if (w == "PICK") {
+	st.pop_back();
+	b--;
+      }
+      if (!pull(k)) return nullptr;
+      push(st[st.size()-k].node, b, pc, false);
+    } else {
+      Shuffle sh;
+      int64_t k = count();
+      while((sh = shuffle(w, st, k)) == Shuffle::underflow) {
+	if (!pull(st.size()+1)) return nullptr;
+      }
+      if (sh != Shuffle::ok) {
+	return nullptr;
+      }
+    }
+  }
+
+  // the entry items that are back in place
+  std::vector<bool> inv(nodes.size(), false), ind(nodes.size(), false);
+  for(size_t n=0; n<nodes.size(); n++) {
+    const Node &nd = nodes[n];
+    switch(nd.kind) {
+    case Node::entry:
+      inv[n] = ((size_t)nd.a < st.size() && st[st.size()-1-nd.a].node == (int)n);
+      break;
+    case Node::index:
+      ind[n] = true;
+      break;
+    case Node::outer:
+    case Node::constant:
+      inv[n] = true;
+      break;
+    case Node::unary:
+      inv[n] = inv[nd.a];
+      break;
+    case Node::binary:
+      inv[n] = inv[nd.a] && inv[nd.b];
+      ind[n] = (affine.count(nd.word) && (ind[nd.a] || ind[nd.b]) &&
+		(ind[nd.a] || inv[nd.a]) && (ind[nd.b] || inv[nd.b]));
+      break;
+    }
+  }
+  auto wanted = [&](int n) { return inv[n] || ind[n]; };
+
+  std::vector<const Made*> spans;
+  for(const auto &m : made) {
+    if (m.op && wanted(m.node) && !(m.parent >= 0 && wanted(made[m.parent].node))) {
+      spans.push_back(&m);
+    }
+  }
+  if (spans.empty()) {
+    return nullptr;
+  }
+  std::sort(spans.begin(), spans.end(), [](const Made *l, const Made *r) { return l->b < r->b; });
+
+  auto plan = std::make_shared<LoopPlan>();
+  plan->preheader = std::make_shared<Progn>(_p, ct_lambda);
+  plan->preheader->_scope = _scope;
+  std::map<int,uint32_t> hoisted, terms;
+
+  // the words that push node n onto the entry stack with extra values above it
+  std::function<void(int,size_t)> emit = [&](int n, size_t extra) {
+    const Node &nd = nodes[n];
+    if (nd.kind == Node::entry) {
+      plan->preheader->addWord(std::to_string(nd.a + 1 + extra));
+      plan->preheader->addWord("PICK");
+    } else if (nd.kind == Node::unary) {
+      emit(nd.a, extra);
+      plan->preheader->addWord(nd.word);
+    } else if (nd.kind == Node::binary) {
+      emit(nd.a, extra);
+      emit(nd.b, extra+1);
+      plan->preheader->addWord(nd.word);
+    } else {
+      plan->preheader->addWord(nd.word);
+    }
+  };
+  auto hoist = [&](int n) {
+    auto hi = hoisted.find(n);
+    if (hi != hoisted.end()) {
+      return hi->second;
+    }
+    emit(n, plan->hoisted.size());
+    plan->hoisted.push_back("");
+    return hoisted[n] = (uint32_t)plan->hoisted.size()-1;
+  };
+  std::function<uint32_t(int)> term = [&](int n) {
+    auto ti = terms.find(n);
+    if (ti != terms.end()) {
+      return ti->second;
+    }
+    const Node &nd = nodes[n];
+    LoopPlan::Term t { LoopPlan::Term::index, 0, 0, 0. };
+    if (nd.kind == Node::constant) {
+      t = { LoopPlan::Term::constant, 0, 0, strtod(nd.word.c_str(), nullptr) };
+    } else if (inv[n]) {
+      t = { LoopPlan::Term::hoisted, hoist(n), 0, 0. };
+    } else if (nd.kind == Node::binary) {
+      if (nd.word == "*" && (nodes[nd.a].kind == Node::index || nodes[nd.b].kind == Node::index) && (inv[nd.a] || inv[nd.b])) {
+	t = { LoopPlan::Term::scaled, term(inv[nd.a] ? nd.a : nd.b), 0, 0. };
+      } else {
+	auto kind = (nd.word == "+") ? LoopPlan::Term::add : (nd.word == "-") ? LoopPlan::Term::sub :
+	  (nd.word == "*") ? LoopPlan::Term::mul : LoopPlan::Term::div;
+	uint32_t a = term(nd.a);
+	t = { kind, a, term(nd.b), 0. };
+      }
+    }
+    plan->terms.push_back(t);
+    return terms[n] = (uint32_t)plan->terms.size()-1;
+  };
+
+  out.generation = in.generation;
+  size_t next = 0;
+  for(auto m : spans) {
+    for(; next < m->b; next++) {
+      out.wordlist.push_back(in.wordlist[next]);
+      out.ctl.push_back(in.ctl[next]);
+    }
+    std::string local;
+    if (inv[m->node]) {
+      uint32_t h = hoist(m->node);
+      local = plan->hoisted[h] = "%h" + std::to_string(h);
+    } else {
+      local = "%n" + std::to_string(plan->inductions.size());
+      plan->inductions.emplace_back(local, term(m->node));
+    }
+    out.wordlist.push_back(local);
+    out.ctl.push_back({ Ctl::word, 0 });
+    next = m->e+1;
+  }
+  for(; next < in.wordlist.size(); next++) {
+    out.wordlist.push_back(in.wordlist[next]);
+    out.ctl.push_back(in.ctl[next]);
+  }
+
+  if (_p._tracing) {
+    printf("FOR %s: %zu hoisted, %zu induction values, %zu of %zu words left\n", _ident.c_str(),
+	   plan->hoisted.size(), plan->inductions.size(), out.wordlist.size(), in.wordlist.size());
+  }
+  return plan;
+}
+
+// runs the preheader on the entry stack, false if the values the terms
+// need aren't numbers (nothing is left on the stack then)
+bool
+Progn::start_loop(rpn::Interp &rpn, const LoopPlan &plan, double start, double end, std::vector<double> &v) {
+  size_t depth = rpn.stack.depth();
+  bool rv = (plan.preheader->eval(rpn) == rpn::WordDefinition::Result::ok &&
+	     rpn.stack.depth() == depth + plan.hoisted.size());
+
+  std::vector<std::unique_ptr<rpn::Stack::Object>> values(plan.hoisted.size());
+  for(size_t h=plan.hoisted.size(); rv && h-- > 0; ) {
+    values[h] = rpn.stack.pop();
+  }
+  while(rpn.stack.depth() > depth) {
+    rpn.stack.drop();
+  }
+
+  // the terms, then a running sum for each scaled term (NaN to multiply)
+  size_t n = plan.terms.size();
+  v.assign(2*n, 0.);
+  for(size_t t=0; rv && t<n; t++) {
+    const auto &term = plan.terms[t];
+    if (term.kind == LoopPlan::Term::constant) {
+      v[t] = term.k;
+    } else if (term.kind == LoopPlan::Term::hoisted) {
+      auto *dp = dynamic_cast<StDouble*>(values[term.a].get());
+      auto *ip = dynamic_cast<StInteger*>(values[term.a].get());
+      rv = (dp || ip);
+      v[t] = (dp) ? (double)dp->val() : (ip) ? (double)(int64_t)ip->val() : 0.;
+    } else if (term.kind == LoopPlan::Term::scaled) {
+      // start the sum one step back, it's exact if all the products are
+      // integers: a whole k and whole indices, so a whole start
+      double k = v[term.a];
+      bool exact = (k == std::floor(k) && start == std::floor(start) &&
+		    std::fabs(k)*std::max(std::fabs(start)+1, std::fabs(end)) < 9007199254740992.);
+      v[n+t] = (exact) ? k*(start-1) : std::nan("");
+    }
+  }
+
+  for(size_t h=0; rv && h<plan.hoisted.size(); h++) {
+    if (plan.hoisted[h].size() > 0) {
+      (*_locals)[plan.hoisted[h]] = std::move(values[h]);
+    }
+  }
+  return rv;
+}
+
+void
+Progn::step_loop(const LoopPlan &plan, double i, std::vector<double> &v) {
+  size_t n = plan.terms.size();
+  for(size_t t=0; t<n; t++) {
+    const auto &term = plan.terms[t];
+    switch(term.kind) {
+    case LoopPlan::Term::index: v[t] = i; break;
+    case LoopPlan::Term::add: v[t] = v[term.a] + v[term.b]; break;
+    case LoopPlan::Term::sub: v[t] = v[term.a] - v[term.b]; break;
+    case LoopPlan::Term::mul: v[t] = v[term.a] * v[term.b]; break;
+    case LoopPlan::Term::div: v[t] = v[term.a] / v[term.b]; break;
+    case LoopPlan::Term::scaled: v[t] = (std::isnan(v[n+t])) ? v[term.a] * i : (v[n+t] += v[term.a]); break;
+    default: break;
+    }
+  }
+  for(const auto &n : plan.inductions) {
+    (*_locals)[n.first] = std::make_unique<StDouble>(StDouble(v[n.second]));
+  }
+}
+
+rpn::WordDefinition::Result
+Progn::eval_mathexpr(rpn::Interp &rpn) {
+  rpn::WordDefinition::Result rv = eval_lambda(rpn);
+  if (rv == rpn::WordDefinition::Result::ok && _ident != "") {
+    // "name = expr"
+    auto val = rpn.stack.pop();
+    if (val) {
+      _p.store_global(_ident, std::move(val));
+    } else {
+      rv = rpn::WordDefinition::Result::param_error;
+    }
+  }
+  return rv;
+}
+
+std::shared_ptr<Progn>
+rpn::Interp::Privates::compile_mathexpr(const std::string &expr) {
+  auto ce = _exprCache.find(expr);
+  if (ce != _exprCache.end()) {
+    _exprOrder.splice(_exprOrder.begin(), _exprOrder, ce->second.second);
+    return ce->second.first;
+  }
+
+  std::vector<std::string> words;
+  std::string assign, err;
+  if (!rpn::infix_to_rpn(expr, words, assign, err)) {
+    printf("expression error: %s in '%s'\n", err.c_str(), expr.c_str());
+    return nullptr;
+  }
+
+  auto progn = std::make_shared<Progn>(*this, ct_mathexpr);
+  for(const auto &w : words) {
+    progn->addWord(w);
+  }
+  progn->_ident = assign;
+  progn->account();
+  if (_exprCache.size() >= expr_cache_max) {
+    _exprCache.erase(_exprOrder.back());
+    _exprOrder.pop_back();
+  }
+  _exprOrder.push_front(expr);
+  _exprCache.emplace(expr, std::make_pair(progn, _exprOrder.begin()));
+  return progn;
+}
+
+rpn::WordDefinition::Result
+Progn::eval(rpn::Interp &rpn) {
+  rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
+  switch (_type) {
+  case ct_worddef:
+    rv = eval_lambda(rpn);
+    break;
+
+  case ct_forloop:
+    rv = eval_forloop(rpn);
+    break;
+
+  case ct_whileloop:
+    rv = eval_whileloop(rpn);
+    break;
+
+  case ct_lambda:
+    rv = eval_lambda(rpn);
+    break;
+
+  case ct_mathexpr:
+    rv = eval_mathexpr(rpn);
+    break;
+  }
+  return rv;
+}
+
+NATIVE_WORD_DECL(private, COMPILED_EVAL)  {
+  Progn *progn = dynamic_cast<Progn*>(ctx);
+  //  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  rpn::WordDefinition::Result rv = (progn) ? rpn::WordDefinition::Result::ok : rpn::WordDefinition::Result::eval_error;
+  if (!progn->_native || !progn->_native->run(rpn.stack)) {
+    rv = progn->eval(rpn);
+  }
+  return rv;
+}
+
+NATIVE_WORD_DECL(private, COLON) {
+  // (rpn::Interp &rpn, rpn::WordContext *ctx, std::string &rest)
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  return p->start_compile(ct_worddef, true);
+}
+
+NATIVE_WORD_DECL(private, ct_SEMICOLON) {
+  // (rpn::Interp &rpn, rpn::WordContext *ctx, std::string &rest)
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+
+  std::shared_ptr<Progn> progp;
+  rpn::WordDefinition::Result rv = p->end_compile(progp, ct_worddef);
+  if (rv == rpn::WordDefinition::Result::ok) {
+
+    if (p->_tracing) {
+      printf("adding '%s' to the dictionary\n", progp->_ident.c_str());
+    }
+
+    bool straight = std::all_of(progp->_ctl.cbegin(), progp->_ctl.cend(), [](const Progn::Ctl &c) { return c.op == Progn::Ctl::word; });
+    if (p->_nativeCode && straight) {
+      progp->_native = rpn::jit::Kernel::compile(progp->_wordlist, [p](const std::string &word) { return p->builtin(word); });
+      if (p->_tracing) {
+	printf("'%s' is %s\n", progp->_ident.c_str(), progp->_native ? "native" : "interpreted");
+      }
+    }
+
+    // a new definition replaces the compiled one, callers see it when they are next run
+    std::string ident = progp->_ident;
+    p->retire(ident);
+    p->_rtDictionary.emplace(ident, rpn::WordDefinition {
+	rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, COMPILED_EVAL), progp.get() });
+    p->track(progp.get());
+    p->_compiled.push_back(std::move(progp));
+    p->_installed++;
+    p->changed(ident);
+
+  } else {
+
+    rv = rpn::WordDefinition::Result::compile_error;
+  }
+  return rv;
+}
+
+NATIVE_WORD_DECL(private, TRACE) {
+  // (rpn::Interp &rpn, rpn::WordContext *ctx, std::string &rest)
+  rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  bool pred = rpn.stack.pop_as_boolean();
+  p->_tracing = pred;
+  return rv;
+}
+
+NATIVE_WORD_DECL(private, NATIVE) {
+  // (rpn::Interp &rpn, rpn::WordContext *ctx, std::string &rest)
+  rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  bool pred = rpn.stack.pop_as_boolean();
+  p->_nativeCode = pred; // applies to words defined from now on
+  return rv;
+}
+
+NATIVE_WORD_DECL(private, WORDLIST) {
+  // (rpn::Interp &rpn, rpn::WordContext *ctx, std::string &rest)
+  rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  std::set<std::string> keys;
+  for(const auto &dw : p->_rtDictionary) {
+    keys.insert(dw.first);
+  }
+  StArray res;
+  for(const auto &k : keys) {
+    res.inner().add_value(StString(k));
+  }
+  rpn.stack.push(res);
+  return rv;
+}
+
+NATIVE_WORD_DECL(private, BOOL_TRUE) {
+  // (rpn::Interp &rpn, rpn::WordContext *ctx, std::string &rest)
+  rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
+  rpn.stack.push_boolean(true);
+  return rv;
+}
+
+NATIVE_WORD_DECL(private, BOOL_FALSE) {
+  // (rpn::Interp &rpn, rpn::WordContext *ctx, std::string &rest)
+  rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
+  rpn.stack.push_boolean(false);
+  return rv;
+}
+
+NATIVE_WORD_DECL(private, OPAREN) {
+  // (rpn::Interp &rpn, rpn::WordContext *ctx, std::string &rest)
+  rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  std::string comment;
+  auto cp = nextWord(comment, rest, ")");
+  if (cp == std::string::npos) {
+    rest = comment; // reset the buffer for future error message
+    rv = rpn::WordDefinition::Result::parse_error;
+  }
+  return rv;
+}
+
+NATIVE_WORD_DECL(private, DQUOTE) {
+  // (rpn::Interp &rpn, rpn::WordContext *ctx, std::string &rest)
+  rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  std::string literal;
+  auto pos = nextWord(literal, rest, "\"");
+  if (pos != std::string::npos) {
+    rpn.stack.push_string(literal);
+  } else {
+    rv = rpn::WordDefinition::Result::parse_error;
+    rest = literal; // reset buffer for error messages and diagnostics
+  }
+  return rv;
+}
+
+NATIVE_WORD_DECL(private, ct_DQUOTE) {
+  // (rpn::Interp &rpn, rpn::WordContext *ctx, std::string &rest)
+  rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  std::string literal;
+  auto pos = nextWord(literal, rest, "\"");
+  if (pos != std::string::npos) {
+    p->_ctVprogn.back()->addWord(".\"");
+    p->_ctVprogn.back()->addWord(literal);
+  } else {
+    rv = rpn::WordDefinition::Result::parse_error;
+    rest = literal; // reset buffer for error messages and diagnostics
+  }
+  return rv;
+}
+
+NATIVE_WORD_DECL(private, EVAL) {
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  std::string expr = rpn.stack.pop_string();
+  auto progn = p->compile_mathexpr(expr);
+  return (progn) ? progn->eval(rpn) : rpn::WordDefinition::Result::parse_error;
+}
+
+NATIVE_WORD_DECL(private, ct_EVAL) {
+  rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  auto &progn = *p->_ctVprogn.back();
+  auto &wl = progn._wordlist;
+  size_t n = wl.size();
+  if (n>=2 && wl[n-2] == ".\"") {
+    // literal expression, compile it now and nest it like a loop body
+    auto expr = p->compile_mathexpr(wl[n-1]);
+    if (expr) {
+      progn.dropWords(2);
+      progn.addNested(std::move(expr)); // shared with the cache
+    } else {
+      rv = rpn::WordDefinition::Result::compile_error;
+    }
+  } else {
+    progn.addWord("EVAL");
+  }
+  return rv;
+}
+
+/*
+ * IF ... [ELSE ...] THEN and CASE v OF ... ENDOF ... [default] ENDCASE
+ * compile to jumps in the body, so only the taken branch is evaluated
+ */
+static rpn::WordDefinition::Result
+mismatched(const std::string &word) {
+  printf("%s: mismatched control structure\n", word.c_str());
+  return rpn::WordDefinition::Result::compile_error;
+}
+
+NATIVE_WORD_DECL(private, ct_IF) {
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  auto &progn = *p->_ctVprogn.back();
+  progn._open.emplace_back("IF", progn.addJump("IF", Progn::Ctl::branch0));
+  return rpn::WordDefinition::Result::ok;
+}
+
+NATIVE_WORD_DECL(private, ct_ELSE) {
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  auto &progn = *p->_ctVprogn.back();
+  if (progn._open.size() == 0 || progn._open.back().first != "IF") {
+    return mismatched("ELSE");
+  }
+  size_t jump = progn.addJump("ELSE", Progn::Ctl::branch);
+  progn.patch(progn._open.back().second);
+  progn._open.back() = { "ELSE", jump };
+  return rpn::WordDefinition::Result::ok;
+}
+
+NATIVE_WORD_DECL(private, ct_THEN) {
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  auto &progn = *p->_ctVprogn.back();
+  if (progn._open.size() == 0 || (progn._open.back().first != "IF" && progn._open.back().first != "ELSE")) {
+    return mismatched("THEN");
+  }
+  progn.patch(progn._open.back().second);
+  progn._open.pop_back();
+  return p->close_lambda();
+}
+
+NATIVE_WORD_DECL(private, ct_CASE) {
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  p->_ctVprogn.back()->_open.emplace_back("CASE", 0);
+  return rpn::WordDefinition::Result::ok;
+}
+
+NATIVE_WORD_DECL(private, ct_OF) {
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  auto &progn = *p->_ctVprogn.back();
+  if (progn._open.size() == 0 || (progn._open.back().first != "CASE" && progn._open.back().first != "ENDOF")) {
+    return mismatched("OF");
+  }
+  progn._open.emplace_back("OF", progn.addJump("OF", Progn::Ctl::of));
+  return rpn::WordDefinition::Result::ok;
+}
+
+NATIVE_WORD_DECL(private, ct_ENDOF) {
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  auto &progn = *p->_ctVprogn.back();
+  if (progn._open.size() == 0 || progn._open.back().first != "OF") {
+    return mismatched("ENDOF");
+  }
+  size_t jump = progn.addJump("ENDOF", Progn::Ctl::branch);
+  progn.patch(progn._open.back().second);
+  progn._open.back() = { "ENDOF", jump };
+  return rpn::WordDefinition::Result::ok;
+}
+
+NATIVE_WORD_DECL(private, ct_ENDCASE) {
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  auto &progn = *p->_ctVprogn.back();
+  if (progn._open.size() == 0 || (progn._open.back().first != "CASE" && progn._open.back().first != "ENDOF")) {
+    return mismatched("ENDCASE");
+  }
+  progn.addWord("DROP"); // the selector, when no OF matched
+  for(; progn._open.back().first == "ENDOF"; progn._open.pop_back()) {
+    progn.patch(progn._open.back().second);
+  }
+  progn._open.pop_back(); // CASE
+  return p->close_lambda();
+}
+
+/*
+ * BEGIN ... cond WHILE ... REPEAT and BEGIN (or DO) ... cond UNTIL jump
+ * back to the BEGIN within the body
+ */
+NATIVE_WORD_DECL(private, ct_BEGIN) {
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  auto &progn = *p->_ctVprogn.back();
+  progn._open.emplace_back("BEGIN", progn._ctl.size());
+  return rpn::WordDefinition::Result::ok;
+}
+
+NATIVE_WORD_DECL(private, ct_DO) {
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  auto &progn = *p->_ctVprogn.back();
+  progn._open.emplace_back("DO", progn._ctl.size());
+  return rpn::WordDefinition::Result::ok;
+}
+
+NATIVE_WORD_DECL(private, ct_WHILE) {
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  auto &progn = *p->_ctVprogn.back();
+  if (progn._open.size() == 0 || progn._open.back().first != "BEGIN") {
+    return mismatched("WHILE");
+  }
+  progn._open.emplace_back("WHILE", progn.addJump("WHILE", Progn::Ctl::branch0));
+  return rpn::WordDefinition::Result::ok;
+}
+
+NATIVE_WORD_DECL(private, ct_REPEAT) {
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  auto &progn = *p->_ctVprogn.back();
+  if (progn._open.size() == 0 || progn._open.back().first != "WHILE") {
+    return mismatched("REPEAT");
+  }
+  size_t exit = progn._open.back().second;
+  progn._open.pop_back();
+  progn.addJump("REPEAT", Progn::Ctl::branch, progn._open.back().second);
+  progn.patch(exit);
+  progn._open.pop_back(); // BEGIN
+  return p->close_lambda();
+}
+
+NATIVE_WORD_DECL(private, ct_UNTIL) {
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  auto &progn = *p->_ctVprogn.back();
+  if (progn._open.size() == 0 || (progn._open.back().first != "BEGIN" && progn._open.back().first != "DO")) {
+    return mismatched("UNTIL");
+  }
+  progn.addJump("UNTIL", Progn::Ctl::branch0, progn._open.back().second);
+  progn._open.pop_back();
+  return p->close_lambda();
+}
+
+NATIVE_WORD_DECL(private, BEGIN) {
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  p->start_compile(ct_whileloop, false);
+  return NATIVE_WORD_FN(private, ct_BEGIN)(rpn, ctx, rest);
+}
+
+NATIVE_WORD_DECL(private, DO) {
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  p->start_compile(ct_whileloop, false);
+  return NATIVE_WORD_FN(private, ct_DO)(rpn, ctx, rest);
+}
+
+NATIVE_WORD_DECL(private, IF) {
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  p->start_compile(ct_lambda, false);
+  return NATIVE_WORD_FN(private, ct_IF)(rpn, ctx, rest);
+}
+
+NATIVE_WORD_DECL(private, CASE) {
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  p->start_compile(ct_lambda, false);
+  return NATIVE_WORD_FN(private, ct_CASE)(rpn, ctx, rest);
+}
+
+NATIVE_WORD_DECL(private, STO) {
+  // ( val name -- )
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  std::string name = rpn.stack.pop_string();
+  p->store_global(name, rpn.stack.pop());
+  return rpn::WordDefinition::Result::ok;
+}
+
+NATIVE_WORD_DECL(private, SEND) {
+  // ( string -- ) a record for the host, see Interp::output(); it stays
+  // on the stack if it can't be sent
+  rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  std::string rec = rpn.stack.peek_string(1);
+  if (rec.size() > p->_output.max_record()) {
+    if (p->_tracing) {
+      printf("SEND: %zu bytes, records are at most %zu\n", rec.size(), p->_output.max_record());
+    }
+    return rpn::WordDefinition::Result::param_error;
+  }
+  while(!p->_output.try_write(rec)) {
+    if (p->interrupted()) {
+      return rpn::WordDefinition::Result::cancelled;
+    }
+    if (p->_tracing) {
+      printf("SEND: output full, waiting\n");
     }
+    p->_output.wait_room(rec.size(), 10ms);
   }
-
-  _p._vlocals.pop_back();
-
+  rpn.stack.drop();
   return rv;
 }
 
-rpn::WordDefinition::Result
-Progn::eval_mathexpr(rpn::Interp &rpn) {
+NATIVE_WORD_DECL(private, RCL) {
+  // ( name -- val )
   rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
+  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
+  std::string name = rpn.stack.pop_string();
+  auto gv = p->_globals.find(name);
+  if (gv != p->_globals.end()) {
+    rpn.stack.push(*gv->second);
+  } else {
+    rv = rpn::WordDefinition::Result::dict_error;
+  }
   return rv;
 }
 
-rpn::WordDefinition::Result
-Progn::eval(rpn::Interp &rpn) {
-  rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
-  switch (_type) {
-  case ct_worddef:
-    rv = eval_lambda(rpn);
-    break;
-
-  case ct_forloop:
-    rv = eval_forloop(rpn);
-    break;
+/*
+ * MAP ( array name -- array ) and REDUCE ( array init name -- value )
+ * apply a word to each element, REDUCE as ( acc x -- acc ).
+ *
+ * Large arrays of doubles are split across cores when the word compiles
+ * natively (see rpn-jit.h): each worker runs the kernel against a stack
+ * of its own and its results land in place in the output.  Anything
+ * else, and small arrays, run here one element at a time.  REDUCE always
+ * folds in order; PARREDUCE folds chunks separately and then the chunks,
+ * which is only the same for an associative word like MAX (and + gives
+ * different roundings), so the caller has to ask for it.
+ */
+static constexpr size_t parallel_min = 4096; // elements, below that the threads cost more than they save
 
-  case ct_whileloop:
-    rv = eval_whileloop(rpn);
-    break;
+bool
+rpn::Interp::Privates::builtin(const std::string &word) {
+  auto range = _rtDictionary.equal_range(word);
+  for(auto we=range.first; we!=range.second; we++) {
+    if (dynamic_cast<Progn*>(we->second.context) != nullptr) {
+      return false;
+    }
+  }
+  return (range.first != range.second);
+}
 
-  case ct_lambda:
-    rv = eval_lambda(rpn);
-    break;
+std::shared_ptr<const rpn::jit::Kernel>
+Progn::kernel() {
+  auto c = code();
+  if (c->loop) {
+    c = c->plain;
+  }
+  if (c != _kernelCode) {
+    _kernelCode = c;
+    _kernel = nullptr;
+    bool straight = std::all_of(c->ctl.cbegin(), c->ctl.cend(), [](const Ctl &ctl) { return ctl.op == Ctl::word; });
+    if (straight) {
+      std::vector<std::string> params;
+      if (_type == ct_forloop) {
+	params.push_back(_ident);
+      }
+      _kernel = rpn::jit::Kernel::compile(c->wordlist, [this](const std::string &w) { return _p.builtin(w); }, params);
+    }
+  }
+  return _kernel;
+}
 
-  case ct_mathexpr:
-    rv = eval_mathexpr(rpn);
-    break;
+std::shared_ptr<const rpn::jit::Kernel>
+rpn::Interp::Privates::parallel_kernel(const std::string &word, size_t inputs) {
+  const rpn::WordDefinition *def = resolve(word);
+  Progn *progn = (def) ? dynamic_cast<Progn*>(def->context) : nullptr;
+  if (progn == nullptr || progn->_type != ct_worddef) {
+    return nullptr;
   }
-  return rv;
+  auto kernel = progn->kernel();
+  return (kernel && kernel->inputs() == inputs && kernel->outputs() == 1) ? kernel : nullptr;
 }
 
-NATIVE_WORD_DECL(private, COMPILED_EVAL)  {
-  Progn *progn = dynamic_cast<Progn*>(ctx);
-  //  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
-  rpn::WordDefinition::Result rv = (progn) ? rpn::WordDefinition::Result::ok : rpn::WordDefinition::Result::eval_error;
-  rv = progn->eval(rpn);
-  return rv;
+// [0, n) in one chunk per worker, the first one on this thread
+static void
+parallel_chunks(size_t n, const std::function<void(size_t chunk, size_t from, size_t to)> &work) {
+  size_t workers = std::max(1u, std::thread::hardware_concurrency());
+  workers = std::min(workers, n / (parallel_min/4));
+  size_t each = (n + workers - 1) / workers;
+  std::vector<std::future<void>> running;
+  for(size_t c=1; c<workers && c*each<n; c++) {
+    running.push_back(std::async(std::launch::async, work, c, c*each, std::min(n, (c+1)*each)));
+  }
+  work(0, 0, std::min(n, each));
+  for(auto &r : running) {
+    r.get();
+  }
 }
 
-NATIVE_WORD_DECL(private, COLON) {
-  // (rpn::Interp &rpn, rpn::WordContext *ctx, std::string &rest)
-  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
-  return p->start_compile(ct_worddef, true);
+static bool
+all_doubles(const std::vector<std::unique_ptr<rpn::Stack::Object>> &v) {
+  return std::all_of(v.cbegin(), v.cend(), [](const std::unique_ptr<rpn::Stack::Object> &e) { return e->type_id() == rpn::Types::t_double; });
 }
 
-NATIVE_WORD_DECL(private, ct_SEMICOLON) {
-  // (rpn::Interp &rpn, rpn::WordContext *ctx, std::string &rest)
+NATIVE_WORD_DECL(private, MAP) {
+  rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
   rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
-
-  Progn *progp=nullptr;
-  rpn::WordDefinition::Result rv = p->end_compile(progp, ct_worddef);
-  if (rv == rpn::WordDefinition::Result::ok) {
-
+  std::string word = rpn.stack.pop_string();
+  auto arr = rpn.stack.pop();
+  auto &in = POP_CAST(StArray, arr).inner().val();
+  size_t n = in.size();
+  std::vector<std::unique_ptr<rpn::Stack::Object>> out(n);
+
+  auto kernel = (n >= parallel_min) ? p->parallel_kernel(word, 1) : nullptr;
+  if (kernel && all_doubles(in)) {
     if (p->_tracing) {
-      printf("adding '%s' to the dictionary\n", progp->_ident.c_str());
+      printf("MAP '%s': %zu elements in parallel\n", word.c_str(), n);
     }
-
-    p->_rtDictionary.emplace(progp->_ident, rpn::WordDefinition {
-	rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, COMPILED_EVAL), progp });
+    p->_parallelMap++;
+    parallel_chunks(n, [&](size_t, size_t from, size_t to) {
+	rpn::Stack ws;
+	std::vector<double> slots;
+	for(size_t i=from; i<to; i++) {
+	  ws.push(*in[i]);
+	  kernel->run(ws, slots);
+	  out[i] = ws.pop();
+	}
+      });
 
   } else {
+    size_t depth = rpn.stack.depth();
+    for(size_t i=0; i<n && rv==rpn::WordDefinition::Result::ok; i++) {
+      std::string rest;
+      rpn.stack.push(*in[i]);
+      rv = p->eval(word, rest);
+      if (rv == rpn::WordDefinition::Result::ok && rpn.stack.depth() != depth+1) {
+	printf("MAP: '%s' has to leave one value for each element\n", word.c_str());
+	rv = rpn::WordDefinition::Result::eval_error;
+      }
+      if (rv == rpn::WordDefinition::Result::ok) {
+	out[i] = rpn.stack.pop();
+      }
+    }
+  }
 
-    rv = rpn::WordDefinition::Result::compile_error;
+  if (rv == rpn::WordDefinition::Result::ok) {
+    StArray result;
+    for(auto &e : out) {
+      result.inner().add_value(std::move(e));
+    }
+    rpn.stack.push(result);
   }
   return rv;
 }
 
-NATIVE_WORD_DECL(private, TRACE) {
-  // (rpn::Interp &rpn, rpn::WordContext *ctx, std::string &rest)
+static rpn::WordDefinition::Result
+reduce(rpn::Interp &rpn, rpn::Interp::Privates *p, bool parallel) {
   rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
-  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
-  bool pred = rpn.stack.pop_as_boolean();
-  p->_tracing = pred;
-  return rv;
-}
+  std::string word = rpn.stack.pop_string();
+  auto init = rpn.stack.pop();
+  auto arr = rpn.stack.pop();
+  auto &in = POP_CAST(StArray, arr).inner().val();
+  size_t n = in.size();
+
+  auto kernel = (parallel && n >= parallel_min) ? p->parallel_kernel(word, 2) : nullptr;
+  if (kernel && all_doubles(in) && init->type_id() == rpn::Types::t_double) {
+    if (p->_tracing) {
+      printf("PARREDUCE '%s': %zu elements in parallel\n", word.c_str(), n);
+    }
+    p->_parallelReduce++;
+    // each chunk after the first starts from its own first element
+    std::vector<std::unique_ptr<rpn::Stack::Object>> partial(std::thread::hardware_concurrency() + 1);
+    parallel_chunks(n, [&](size_t chunk, size_t from, size_t to) {
+	rpn::Stack ws;
+	std::vector<double> slots;
+	ws.push((chunk == 0) ? *init : *in[from++]);
+	for(size_t i=from; i<to; i++) {
+	  ws.push(*in[i]);
+	  kernel->run(ws, slots);
+	}
+	partial[chunk] = ws.pop();
+      });
+    rpn::Stack ws;
+    ws.push(*partial[0]);
+    for(size_t c=1; c<partial.size() && partial[c]; c++) {
+      ws.push(*partial[c]);
+      kernel->run(ws);
+    }
+    rpn.stack.push(*ws.pop());
 
-NATIVE_WORD_DECL(private, WORDLIST) {
-  // (rpn::Interp &rpn, rpn::WordContext *ctx, std::string &rest)
-  rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
-  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
-  std::set<std::string> keys;
-  for(const auto &dw : p->_rtDictionary) {
-    keys.insert(dw.first);
-  }
-  StArray res;
-  for(const auto &k : keys) {
-    res.inner().add_value(StString(k));
+  } else {
+    size_t depth = rpn.stack.depth();
+    rpn.stack.push(*init);
+    for(size_t i=0; i<n && rv==rpn::WordDefinition::Result::ok; i++) {
+      std::string rest;
+      rpn.stack.push(*in[i]);
+      rv = p->eval(word, rest);
+      if (rv == rpn::WordDefinition::Result::ok && rpn.stack.depth() != depth+1) {
+	printf("REDUCE: '%s' has to combine two values into one\n", word.c_str());
+	rv = rpn::WordDefinition::Result::eval_error;
+      }
+    }
   }
-  rpn.stack.push(res);
   return rv;
 }
 
-NATIVE_WORD_DECL(private, BOOL_TRUE) {
-  // (rpn::Interp &rpn, rpn::WordContext *ctx, std::string &rest)
-  rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
-  rpn.stack.push_boolean(true);
-  return rv;
+NATIVE_WORD_DECL(private, REDUCE) {
+  return reduce(rpn, dynamic_cast<rpn::Interp::Privates*>(ctx), false);
 }
 
-NATIVE_WORD_DECL(private, BOOL_FALSE) {
-  // (rpn::Interp &rpn, rpn::WordContext *ctx, std::string &rest)
-  rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
-  rpn.stack.push_boolean(false);
-  return rv;
+NATIVE_WORD_DECL(private, PARREDUCE) {
+  return reduce(rpn, dynamic_cast<rpn::Interp::Privates*>(ctx), true);
 }
 
-NATIVE_WORD_DECL(private, OPAREN) {
-  // (rpn::Interp &rpn, rpn::WordContext *ctx, std::string &rest)
-  rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
-  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
-  std::string comment;
-  auto cp = nextWord(comment, rest, ")");
-  if (cp == std::string::npos) {
-    rest = comment; // reset the buffer for future error message
-    rv = rpn::WordDefinition::Result::parse_error;
+/*
+ * PARFOR i ... NEXT is FOR i ... NEXT, run in parallel when that can't
+ * change the result: the body compiles natively and leaves its inputs
+ * on top as they were, pushing its results under them, so no iteration
+ * sees another's results.  Chunks of the index range then run on
+ * workers, each on a stack seeded with the inputs, and the results go
+ * back in index order.  (bolt-circle has that shape, but makes vec3s,
+ * which the kernels don't, so it runs as a FOR loop.)
+ *
+ * A loop that would go past the request's word budget or the memory
+ * limit runs as a FOR loop too, which stops at the word that does; the
+ * workers give up on cancel() and the time budget.
+ */
+bool
+Progn::eval_parfor(rpn::Interp &rpn, double start, double end, rpn::WordDefinition::Result &rv) {
+  // start + t is what "start += 1" gives only for whole numbers
+  size_t trips = (start < end) ? (size_t)std::ceil(end - start) : 0;
+  if (trips < parallel_min || std::floor(start) != start || std::fabs(start) > 0x1p52) {
+    return false;
+  }
+  auto k = kernel();
+  if (!k || !k->keeps_inputs() || rpn.stack.depth() < k->inputs()) {
+    return false;
+  }
+  size_t nin = k->inputs();
+  size_t nout = k->outputs() - nin;
+  std::vector<std::unique_ptr<rpn::Stack::Object>> inputs; // bottom first
+  for(size_t i=nin; i>0; i--) {
+    if (rpn.stack.type((int)i) != rpn::Types::t_double) {
+      return false;
+    }
+    inputs.push_back(rpn.stack.peek((int)i).deep_copy());
   }
-  return rv;
-}
 
-NATIVE_WORD_DECL(private, DQUOTE) {
-  // (rpn::Interp &rpn, rpn::WordContext *ctx, std::string &rest)
-  rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
-  rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
-  std::string literal;
-  auto pos = nextWord(literal, rest, "\"");
-  if (pos != std::string::npos) {
-    rpn.stack.push_string(literal);
-  } else {
-    rv = rpn::WordDefinition::Result::parse_error;
-    rest = literal; // reset buffer for error messages and diagnostics
+  uint64_t words = trips * (code()->wordlist.size() + 1);
+  size_t hard = _p._hardLimit;
+  if ((_p._words + words >= _p._wordLimit) ||
+      (hard && _p.memory_used() + trips * nout * StDouble(0.0).footprint() > hard)) {
+    return false;
   }
-  return rv;
+
+  if (_p._tracing) {
+    printf("PARFOR %s: %zu iterations in parallel\n", _ident.c_str(), trips);
+  }
+  _p._parallelFor++;
+  uint64_t runId = _p._runId;
+  auto deadline = _p._deadline;
+  std::atomic<bool> stopped(false);
+  std::vector<std::unique_ptr<rpn::Stack::Object>> out(trips * nout);
+  parallel_chunks(trips, [&](size_t, size_t from, size_t to) {
+      rpn::Stack ws;
+      std::vector<double> slots;
+      for(size_t t=from; t<to; t++) {
+	if ((t & 0xff) == 0 &&
+	    (stopped || _p._cancelId.load(std::memory_order_relaxed) == runId || std::chrono::steady_clock::now() >= deadline)) {
+	  stopped = true;
+	  return;
+	}
+	for(const auto &in : inputs) {
+	  ws.push(*in);
+	}
+	double i = start + (double)t;
+	k->run(ws, slots, &i);
+	ws.dropn((int)nin);
+	for(size_t m=nout; m>0; m--) {
+	  out[t*nout + m-1] = ws.pop();
+	}
+      }
+    });
+  _p._words += words;
+  if (stopped) {
+    rv = rpn::WordDefinition::Result::cancelled;
+    return true;
+  }
+
+  rpn.stack.dropn((int)nin);
+  rpn.stack.reserve(rpn.stack.depth() + out.size() + nin);
+  for(const auto &o : out) {
+    rpn.stack.push(*o);
+  }
+  for(const auto &in : inputs) {
+    rpn.stack.push(*in);
+  }
+  rv = rpn::WordDefinition::Result::ok;
+  return true;
 }
 
-NATIVE_WORD_DECL(private, ct_DQUOTE) {
-  // (rpn::Interp &rpn, rpn::WordContext *ctx, std::string &rest)
-  rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
+NATIVE_WORD_DECL(private, PARFOR) {
   rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
-  std::string literal;
-  auto pos = nextWord(literal, rest, "\"");
-  if (pos != std::string::npos) {
-    p->_ctVprogn.back().addWord(".\"");
-    p->_ctVprogn.back().addWord(literal);
-  } else {
-    rv = rpn::WordDefinition::Result::parse_error;
-    rest = literal; // reset buffer for error messages and diagnostics
-  }
+  rpn::WordDefinition::Result rv = p->start_compile(ct_forloop, true);
+  p->_ctVprogn.back()->_parallel = true;
   return rv;
 }
 
@@ -451,8 +2676,8 @@ NATIVE_WORD_DECL(private, FOR) {
 NATIVE_WORD_DECL(private, ct_FOR) {
   rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
   rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
-  //  if (p->_ctVprogn.back()._type == ct_worddef) {
-  //    p->_ctVprogn.back().addWord("FOR");
+  //  if (p->_ctVprogn.back()->_type == ct_worddef) {
+  //    p->_ctVprogn.back()->addWord("FOR");
   //  } else {
     rv = p->start_compile(ct_forloop, true);
     //  }
@@ -463,33 +2688,59 @@ rpn::WordDefinition::Result
 rpn::Interp::Privates::start_compile(CompileType t, bool needIdent) {
   rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
   _needIdent = needIdent;
-  _ctVprogn.push_back(Progn(*this, t));
+  _ctVprogn.push_back(std::make_unique<Progn>(*this, t));
   return rv;
 }
 
 rpn::WordDefinition::Result
-rpn::Interp::Privates::end_compile(Progn *&progp, CompileType t) {
-  rpn::WordDefinition::Result rv = ((_ctVprogn.size()>0) && _ctVprogn.back()._type == t)?
+rpn::Interp::Privates::end_compile(std::shared_ptr<Progn> &progp, CompileType t) {
+  rpn::WordDefinition::Result rv = ((_ctVprogn.size()>0) && _ctVprogn.back()->_type == t)?
     rpn::WordDefinition::Result::ok : rpn::WordDefinition::Result::compile_error;
 
+  if (rv == rpn::WordDefinition::Result::ok && _ctVprogn.back()->_open.size() > 0) {
+    printf("unterminated %s\n", _ctVprogn.back()->_open.back().first.c_str());
+    rv = rpn::WordDefinition::Result::compile_error;
+  }
+
   progp=nullptr;
   if (rv == rpn::WordDefinition::Result::ok) {
-    progp = new Progn(_ctVprogn.back());
+    for(const auto &pn : _ctVprogn) {
+      if (pn->_type == ct_forloop) {
+	_ctVprogn.back()->_scope.push_back(pn->_ident);
+      }
+    }
+    progp = std::move(_ctVprogn.back());
     _ctVprogn.pop_back();
+    progp->account();
   }
 
   return rv;
 }
 
+// a control construct typed at top level runs once its outermost end is compiled
+rpn::WordDefinition::Result
+rpn::Interp::Privates::close_lambda() {
+  rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
+  CompileType t = _ctVprogn.back()->_type;
+  if ((t == ct_lambda || t == ct_whileloop) && _ctVprogn.back()->_open.size() == 0) {
+    std::shared_ptr<Progn> progp;
+    rv = end_compile(progp, t);
+    if (rv == rpn::WordDefinition::Result::ok) {
+      rv = progp->eval(_rpn);
+    }
+  }
+  return rv;
+}
+
 NATIVE_WORD_DECL(private, ct_NEXT) {
   rpn::Interp::Privates *p = dynamic_cast<rpn::Interp::Privates*>(ctx);
   rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
 
-  /*  if (p->_ctVprogn.back()._type == ct_worddef) {
-    p->_ctVprogn.back().addWord("NEXT");
+  /*  if (p->_ctVprogn.back()->_type == ct_worddef) {
+    p->_ctVprogn.back()->addWord("NEXT");
 
     } else */ {
-    Progn *progp=nullptr;
+    std::shared_ptr<Progn> progp;
 
     rv = p->end_compile(progp, ct_forloop);
 
@@ -499,17 +2750,10 @@ NATIVE_WORD_DECL(private, ct_NEXT) {
 	// back to top level, evaluate here
 	rv = progp->eval(rpn);
 
-	delete progp;
-	//	p->_locals.clear();
-
       } else {
 
 	// in a definition or nested loops
-
-	std::string word = std::to_string((uint64_t)progp);
-	p->_ctVprogn.back()._locals->emplace(word, progp);
-	//	delete progp; who owns progp???
-	p->_ctVprogn.back().addWord(word);
+	p->_ctVprogn.back()->addNested(std::move(progp));
       }
 
     } else {
@@ -534,8 +2778,21 @@ rpn::Interp::Privates::add_private_words() {
   _rtDictionary.emplace("(", rpn::WordDefinition { rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, OPAREN), this });
   _rtDictionary.emplace(".\"", rpn::WordDefinition { rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, DQUOTE), this });
   _rtDictionary.emplace("FOR", rpn::WordDefinition { rpn::StrictTypeValidator::d2_integer_integer, NATIVE_WORD_FN(private, FOR), this });
+  _rtDictionary.emplace("PARFOR", rpn::WordDefinition { rpn::StrictTypeValidator::d2_integer_integer, NATIVE_WORD_FN(private, PARFOR), this });
   _rtDictionary.emplace("TRACE", rpn::WordDefinition { rpn::StrictTypeValidator::d1_boolean, NATIVE_WORD_FN(private, TRACE), this });
+  _rtDictionary.emplace("IF", rpn::WordDefinition { rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, IF), this });
+  _rtDictionary.emplace("CASE", rpn::WordDefinition { rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, CASE), this });
+  _rtDictionary.emplace("BEGIN", rpn::WordDefinition { rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, BEGIN), this });
+  _rtDictionary.emplace("DO", rpn::WordDefinition { rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, DO), this });
+  _rtDictionary.emplace("NATIVE", rpn::WordDefinition { rpn::StrictTypeValidator::d1_boolean, NATIVE_WORD_FN(private, NATIVE), this });
   _rtDictionary.emplace("WORDLIST", rpn::WordDefinition { rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, WORDLIST), this });
+  _rtDictionary.emplace("EVAL", rpn::WordDefinition { rpn::StrictTypeValidator::d1_string, NATIVE_WORD_FN(private, EVAL), this });
+  _rtDictionary.emplace("STO", rpn::WordDefinition { rpn::StrictTypeValidator::d2_string_any, NATIVE_WORD_FN(private, STO), this });
+  _rtDictionary.emplace("SEND", rpn::WordDefinition { rpn::StrictTypeValidator::d1_string, NATIVE_WORD_FN(private, SEND), this });
+  _rtDictionary.emplace("RCL", rpn::WordDefinition { rpn::StrictTypeValidator::d1_string, NATIVE_WORD_FN(private, RCL), this });
+  _rtDictionary.emplace("MAP", rpn::WordDefinition { rpn::StrictTypeValidator::d2_string_array, NATIVE_WORD_FN(private, MAP), this });
+  _rtDictionary.emplace("REDUCE", rpn::WordDefinition { rpn::StrictTypeValidator::d3_string_any_array, NATIVE_WORD_FN(private, REDUCE), this });
+  _rtDictionary.emplace("PARREDUCE", rpn::WordDefinition { rpn::StrictTypeValidator::d3_string_any_array, NATIVE_WORD_FN(private, PARREDUCE), this });
 
   //  rpn.addDefinition("<true>", { rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, BOOL_TRUE), this });
   //  rpn.addDefinition("<false>", { rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, BOOL_FALSE), this });
@@ -544,12 +2801,26 @@ rpn::Interp::Privates::add_private_words() {
   _ctDictionary.emplace("(", rpn::WordDefinition { rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, OPAREN), this });
   _ctDictionary.emplace(".\"", rpn::WordDefinition { rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, ct_DQUOTE), this });
   _ctDictionary.emplace("FOR", rpn::WordDefinition { rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, ct_FOR), this });
+  _ctDictionary.emplace("PARFOR", rpn::WordDefinition { rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, PARFOR), this });
   _ctDictionary.emplace("NEXT", rpn::WordDefinition { rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, ct_NEXT), this });
   _ctDictionary.emplace("STEP", rpn::WordDefinition { rpn::StrictTypeValidator::d1_double, NATIVE_WORD_FN(private, ct_STEP), this });
+  _ctDictionary.emplace("EVAL", rpn::WordDefinition { rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, ct_EVAL), this });
+  _ctDictionary.emplace("IF", rpn::WordDefinition { rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, ct_IF), this });
+  _ctDictionary.emplace("ELSE", rpn::WordDefinition { rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, ct_ELSE), this });
+  _ctDictionary.emplace("THEN", rpn::WordDefinition { rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, ct_THEN), this });
+  _ctDictionary.emplace("CASE", rpn::WordDefinition { rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, ct_CASE), this });
+  _ctDictionary.emplace("OF", rpn::WordDefinition { rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, ct_OF), this });
+  _ctDictionary.emplace("ENDOF", rpn::WordDefinition { rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, ct_ENDOF), this });
+  _ctDictionary.emplace("BEGIN", rpn::WordDefinition { rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, ct_BEGIN), this });
+  _ctDictionary.emplace("DO", rpn::WordDefinition { rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, ct_DO), this });
+  _ctDictionary.emplace("WHILE", rpn::WordDefinition { rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, ct_WHILE), this });
+  _ctDictionary.emplace("REPEAT", rpn::WordDefinition { rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, ct_REPEAT), this });
+  _ctDictionary.emplace("UNTIL", rpn::WordDefinition { rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, ct_UNTIL), this });
+  _ctDictionary.emplace("ENDCASE", rpn::WordDefinition { rpn::StackSizeValidator::zero, NATIVE_WORD_FN(private, ct_ENDCASE), this });
 }
 
 rpn::WordDefinition::Result
-rpn::Interp::Privates::eval(const std::string &word, std::string &rest) {
+rpn::Interp::Privates::eval(const std::string &word, std::string &rest, const rpn::WordDefinition *bound) {
   if (_tracing)
     printf("evaluating: '%s' '%s'\n", word.c_str(), rest.c_str());
 
@@ -564,6 +2835,9 @@ rpn::Interp::Privates::eval(const std::string &word, std::string &rest) {
   if (_ctVprogn.size() != 0) {
     try {
       rv = compiletime_eval(word,rest);
+      if (rv == rpn::WordDefinition::Result::compile_error) {
+	_ctVprogn.clear(); // the definition is abandoned
+      }
 
     } catch (const std::bad_cast &/*bce*/) {
       msg = "type error compiling";
@@ -579,8 +2853,10 @@ rpn::Interp::Privates::eval(const std::string &word, std::string &rest) {
     }
 
   } else {
+    size_t before = (_hardLimit) ? memory_used() : 0;
     try {
-      rv = runtime_eval(word,rest);
+      // bound call sites were proven to fit when the body was inferred
+      rv = (bound) ? bound->invoke(_rpn, rest) : runtime_eval(word,rest);
 
     } catch (const std::bad_cast &/*bce*/) {
       rv = rpn::WordDefinition::Result::param_error;
@@ -591,6 +2867,13 @@ rpn::Interp::Privates::eval(const std::string &word, std::string &rest) {
       rv = rpn::WordDefinition::Result::param_error;
       msg = "eval error";
       if (rest.size()>0) msg += (std::string(" '") + rest + "'");
+
+    } catch (const std::bad_alloc &/*bae*/) {
+      rv = rpn::WordDefinition::Result::memory_error;
+    }
+
+    if (rv == rpn::WordDefinition::Result::ok && (_softLimit || _hardLimit) && over_limit(before)) {
+      rv = rpn::WordDefinition::Result::memory_error;
     }
   }
 
@@ -635,6 +2918,18 @@ rpn::Interp::Privates::eval(const std::string &word, std::string &rest) {
       if (rest.size()>0) msg += (std::string(" '") + rest + "'");
     }
       break;
+
+    case rpn::WordDefinition::Result::cancelled: {
+      msg = "cancelled";
+      rest = "";
+    }
+      break;
+
+    case rpn::WordDefinition::Result::memory_error: {
+      msg = "out of memory";
+      rest = "";
+    }
+      break;
     }
   }
 
@@ -667,12 +2962,18 @@ rpn::Interp::Privates::runtime_eval(const std::string &word, std::string &rest)
     if (word_exists(word)) {
       auto we = validate_word(word, _rpn.stack);
       if (we != _rtDictionary.end()) {
-	rv = we->second.eval(_rpn,  we->second.context, rest);
+	rv = we->second.invoke(_rpn, rest);
       } else {
 	rv = rpn::WordDefinition::Result::param_error;
       }
     } else {
-      // default to dictionary error
+      auto gv = _globals.find(word);
+      if (gv != _globals.end()) {
+	// variables push their value
+	_rpn.stack.push(*gv->second);
+	rv = rpn::WordDefinition::Result::ok;
+      }
+      // otherwise default to dictionary error
     }
   }
   return rv;
@@ -682,7 +2983,7 @@ bool
 rpn::Interp::Privates::is_local_variable(const std::string &word) {
   bool rv = false;
   for(auto  pn =_ctVprogn.cbegin(); rv==false && pn != _ctVprogn.cend(); pn++) {
-    rv = (rv || (word == pn->_ident) || (pn->_locals->find(word)!=pn->_locals->end()));
+    rv = (rv || (word == (*pn)->_ident) || ((*pn)->_locals->find(word)!=(*pn)->_locals->end()));
   }
   return rv;
 }
@@ -690,7 +2991,7 @@ rpn::Interp::Privates::is_local_variable(const std::string &word) {
 bool
 rpn::Interp::Privates::find_local_variable(var_dict_t::const_iterator &var, const std::string &word) {
   bool rv = false;
-  for(auto  pn =_vlocals.crbegin(); rv==false && pn != _vlocals.crend(); pn++) {
+  for(auto  pn =_vlocals.crbegin(); rv==false && pn != _vlocals.crend() - _vlocalsFloor; pn++) {
     var = (*pn)->find(word);
     rv = (var != (*pn)->end());
   }
@@ -700,7 +3001,7 @@ rpn::Interp::Privates::find_local_variable(var_dict_t::const_iterator &var, cons
 rpn::WordDefinition::Result
 rpn::Interp::Privates::compiletime_eval(const std::string &word, std::string &rest) {
   rpn::WordDefinition::Result rv=rpn::WordDefinition::Result::dict_error;
-  auto &progn = _ctVprogn.back();
+  auto &progn = *_ctVprogn.back();
   
   if (_needIdent && (progn._ident=="")) {
     progn._ident = word;
@@ -712,14 +3013,14 @@ rpn::Interp::Privates::compiletime_eval(const std::string &word, std::string &re
     const auto &cw = _ctDictionary.find(word);
     if (cw != _ctDictionary.end()) {
       // found something in the compiletime dict, evaluate it
-      rv = cw->second.eval(_rpn, cw->second.context, rest);
+      rv = cw->second.invoke(_rpn, rest);
 
     } else if (std::isdigit(word[0])) {
       // numbers just push
       progn.addWord(word);
       rv=rpn::WordDefinition::Result::ok;
 
-    } else if (is_local_variable(word)) {
+    } else if (is_local_variable(word) || _globals.find(word) != _globals.end()) {
       // if we're in a loop compiling mode; and this is the loop variable,
       // push it
       progn.addWord(word);
@@ -728,7 +3029,9 @@ rpn::Interp::Privates::compiletime_eval(const std::string &word, std::string &re
     } else {
       // everything else, we check in the runtime dictionary
       const auto &rw = _rtDictionary.find(word);
-      if (rw != _rtDictionary.end()) {
+      if (rw != _rtDictionary.end() ||
+	  (_ctVprogn.front()->_type == ct_worddef && _ctVprogn.front()->_ident == word)) {
+	// the word being defined can call itself
 	progn.addWord(word);
 	rv=rpn::WordDefinition::Result::ok;
 
@@ -767,23 +3070,41 @@ rpn::Interp::status() {
 bool
 rpn::Interp::addDefinition(const std::string &word, const WordDefinition &def) {
   m_p->_rtDictionary.emplace(word, def);
+  m_p->changed(word);
   return true;
 }
 
 bool
 rpn::Interp::removeDefinition(const std::string &word) {
+  m_p->retire(word);
   m_p->_rtDictionary.erase(word);
+  m_p->changed(word);
   return true;
 }
 
+const rpn::WordDefinition *
+rpn::Interp::Privates::resolve(const std::string &word) {
+  const rpn::WordDefinition *rv = nullptr;
+  if (!(std::isdigit(word[0])||(word[0]=='-'&&std::isdigit(word[1])))) {
+    try {
+      auto we = validate_word(word, _rpn.stack);
+      if (we != _rtDictionary.end()) {
+	rv = &we->second;
+      }
+    } catch (const std::exception &/*e*/) {
+      // eval reports it
+    }
+  }
+  return rv;
+}
+
 std::multimap<std::string,rpn::WordDefinition>::iterator
 rpn::Interp::Privates::validate_word(const std::string &word, rpn::Stack &stack) {
   const auto &beg = _rtDictionary.lower_bound(word);
   const auto &end = _rtDictionary.upper_bound(word);
   if (beg != end) {
-    auto stack_types = stack.types();
     for(auto we=beg; we!=end; we++) {
-      if (we->second.validator(stack_types, stack)) {
+      if (we->second.validator(stack)) {
 	return we;
       }
     }
@@ -809,44 +3130,206 @@ rpn::Interp::wordExists(const std::string &word) {
 }
 
 void
-rpn::Interp::eval(std::string line, std::function<void(rpn::WordDefinition::Result)>completionHandler) {
+rpn::Interp::eval(std::string line, std::function<void(rpn::WordDefinition::Result)>completionHandler, Priority prio) {
   //  rpn::WordDefinition::Result rv = m_p->parse(line);
   //  completionHandler(rv);
-  m_p->queue_request("eval", line, completionHandler);
+  m_p->queue_request("eval", line, completionHandler, prio);
+}
+
+// a request whose completion fulfils a promise, run on the interpreter thread
+static rpn::Interp::Privates::Request
+reply_request(rpn::Interp &rpn, const std::string &line, size_t capture, std::future<rpn::Interp::Reply> &future) {
+  auto promise = std::make_shared<std::promise<rpn::Interp::Reply>>();
+  future = promise->get_future();
+  return { "eval", line, [&rpn, promise, capture](rpn::WordDefinition::Result rv) {
+      rpn::Interp::Reply reply { rv, {} };
+      size_t n = std::min(capture, rpn.stack.depth());
+      for(size_t i=1; i<=n; i++) {
+	reply.outputs.push_back(rpn.stack.peek((int)i).deep_copy());
+      }
+      promise->set_value(std::move(reply));
+    } };
+}
+
+std::future<rpn::Interp::Reply>
+rpn::Interp::submit(std::string line, size_t capture, Priority prio) {
+  std::future<Reply> rv;
+  std::vector<Privates::Request> reqs;
+  reqs.push_back(reply_request(*this, line, capture, rv));
+  m_p->queue_requests(std::move(reqs), prio);
+  return rv;
+}
+
+std::vector<std::future<rpn::Interp::Reply>>
+rpn::Interp::submit(const std::vector<std::string> &lines, size_t capture, Priority prio) {
+  std::vector<std::future<Reply>> rv(lines.size());
+  std::vector<Privates::Request> reqs;
+  reqs.reserve(lines.size());
+  for(size_t i=0; i<lines.size(); i++) {
+    reqs.push_back(reply_request(*this, lines[i], capture, rv[i]));
+  }
+  m_p->queue_requests(std::move(reqs), prio);
+  return rv;
 }
 
 rpn::WordDefinition::Result
 rpn::Interp::sync_eval(std::string line) {
-  return m_p->parse(line);
+  auto rv = m_p->parse(line);
+  m_p->finish(rv);
+  stack.checkpoint();
+  stack.publish(m_p->_status);
+  return rv;
+}
+
+void
+rpn::Interp::saveStack(const std::string &path, std::function<void(rpn::WordDefinition::Result)>completionHandler) {
+  m_p->queue_request("saveStack", path, completionHandler, Priority::interactive);
+}
+
+void
+rpn::Interp::restoreStack(const std::string &path, std::function<void(rpn::WordDefinition::Result)>completionHandler) {
+  m_p->queue_request("restoreStack", path, completionHandler, Priority::interactive);
+}
+
+void
+rpn::Interp::undo(std::function<void(rpn::WordDefinition::Result)>completionHandler) {
+  m_p->queue_request("eval", "UNDO", completionHandler, Priority::interactive);
+}
+
+void
+rpn::Interp::redo(std::function<void(rpn::WordDefinition::Result)>completionHandler) {
+  m_p->queue_request("eval", "REDO", completionHandler, Priority::interactive);
+}
+
+void
+rpn::Interp::budget(const Budget &b) {
+  m_p->set_budget(b);
+}
+
+void
+rpn::Interp::cancel() {
+  m_p->cancel();
+}
+
+void
+rpn::Interp::quantum(std::chrono::milliseconds q) {
+  m_p->_quantumMs = q.count();
 }
 
 void
-rpn::Interp::parseFile(const std::string &path, std::function<void(rpn::WordDefinition::Result)>completionHandler) {
+rpn::Interp::parseFile(const std::string &path, std::function<void(rpn::WordDefinition::Result)>completionHandler, Priority prio) {
   //  rpn::WordDefinition::Result rv = m_p->sync_parse_file(path);
   //  completionHandler(rv);
-  m_p->queue_request("parseFile", path, completionHandler);
+  m_p->queue_request("parseFile", path, completionHandler, prio);
+}
+
+void
+rpn::Interp::reloadFile(const std::string &path, std::function<void(rpn::WordDefinition::Result)>completionHandler, Priority prio) {
+  m_p->queue_request("reloadFile", path, completionHandler, prio);
+}
+
+rpn::Interp::LaneStats
+rpn::Interp::laneStats(Priority lane) {
+  return m_p->lane_stats(lane);
+}
+
+rpn::Interp::ParallelStats
+rpn::Interp::parallelStats() {
+  ParallelStats rv;
+  rv.map = m_p->_parallelMap;
+  rv.reduce = m_p->_parallelReduce;
+  rv.parfor = m_p->_parallelFor;
+  return rv;
+}
+
+rpn::OutputChannel &
+rpn::Interp::output() {
+  return m_p->_output;
+}
+
+void
+rpn::Interp::outputSink(std::shared_ptr<OutputSink> sink) {
+  m_p->output_sink(sink);
+}
+
+rpn::Interp::MemoryStats
+rpn::Interp::memoryStats() {
+  MemoryStats rv;
+  rv.words = m_p->_installed;
+  rv.progns = m_p->_progns;
+  rv.code = m_p->_prognBytes;
+  rv.stack = stack.bytes();
+  rv.history = stack.history_bytes();
+  rv.variables = m_p->_globalBytes;
+  rv.total = rv.code + rv.stack + rv.history + rv.variables;
+  rv.peak = std::max<size_t>(m_p->_peak, rv.total);
+  rv.over_soft = m_p->_softLimit && m_p->_overSoft;
+  return rv;
+}
+
+void
+rpn::Interp::memoryLimits(const MemoryLimits &limits) {
+  m_p->_softLimit = limits.soft;
+  m_p->_hardLimit = limits.hard;
 }
 
 /*
  */
 
+rpn::StrictTypeValidator::StrictTypeValidator(const std::vector<TypeId> &types) : _n(types.size()) {
+  if (_n > max_types) {
+    throw std::length_error("StrictTypeValidator: too many types");
+  }
+  std::copy(types.cbegin(), types.cend(), _types.begin());
+}
+
 bool
-rpn::StrictTypeValidator::operator()(const std::vector<size_t> &types, rpn::Stack &stack) const {
-  bool rv = types.size() >= _types.size();
-  for(auto si=types.cbegin(), wi=_types.cbegin(); rv==true && wi!=_types.cend(); si++, wi++) {
-    rv &= ((*wi==v_anytype) || (*si == *wi));
+rpn::StrictTypeValidator::operator()(rpn::Stack &stack) const {
+  bool rv = stack.depth() >= _n;
+  for(size_t i=0; rv && i<_n; i++) {
+    rv = ((_types[i]==v_anytype) || (stack.type((int)i+1) == _types[i]));
   }
   return rv;
 }
 
 bool
-rpn::StackSizeValidator::operator()(const std::vector<size_t> &types, rpn::Stack &stack) const {
+rpn::StackSizeValidator::operator()(rpn::Stack &stack) const {
   bool rv = false;
-  if ((_n==(size_t)-1) && types.size()>0 && types[0]==typeid(StInteger).hash_code()) { // negative means to ntos - check top of stack as integer and make sure that the stack is >=
-    auto &nn = dynamic_cast<const StInteger&>(stack.peek(1));
-    rv = (types.size()-1) >= nn.val();
+  size_t depth = stack.depth();
+  if ((_n==(size_t)-1) && stack.type(1)==Types::t_integer) { // negative means to ntos - check top of stack as integer and make sure that the stack is >=
+    auto &nn = static_cast<const StInteger&>(stack.peek(1));
+    rv = (uint64_t)(depth-1) >= (uint64_t)nn.val();
+  } else {
+    rv = (depth >=_n);
+  }
+  return rv;
+}
+
+rpn::StackValidator::Proof
+rpn::StrictTypeValidator::prove(const std::vector<TypeId> &known, const int64_t *tos) const {
+  if (known.size() < _n) {
+    return Proof::deeper;
+  }
+  bool rv = true;
+  for(size_t i=0; rv && i<_n; i++) {
+    rv = ((_types[i]==v_anytype) || (known[i] == _types[i]));
+  }
+  return rv ? Proof::accept : Proof::reject;
+}
+
+rpn::StackValidator::Proof
+rpn::StackSizeValidator::prove(const std::vector<TypeId> &known, const int64_t *tos) const {
+  Proof rv = Proof::unknown;
+  if (_n==(size_t)-1) {
+    if (known.size() == 0) {
+      rv = Proof::deeper;
+    } else if (known[0] != Types::t_integer) {
+      rv = Proof::reject;
+    } else if (tos != nullptr) {
+      rv = ((uint64_t)(known.size()-1) >= (uint64_t)*tos) ? Proof::accept : Proof::deeper;
+    }
   } else {
-    rv = (types.size() >=_n);
+    rv = (known.size() >= _n) ? Proof::accept : Proof::deeper;
   }
   return rv;
 }
@@ -855,53 +3338,55 @@ rpn::StackSizeValidator::operator()(const std::vector<size_t> &types, rpn::Stack
  * canned validators for common stack depth/types
  *
  */
-const size_t rpn::StrictTypeValidator::v_anytype = typeid(rpn::Stack::Object).hash_code();
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d1_double({typeid(StDouble).hash_code()});
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d1_integer({typeid(StInteger).hash_code()});
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d1_boolean({typeid(StBoolean).hash_code()});
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d1_string({typeid(StString).hash_code()});
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d1_vec3({typeid(StVec3).hash_code()});
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d1_object({typeid(StObject).hash_code()});
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d1_array({typeid(StArray).hash_code()});
-
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_boolean_boolean({typeid(StBoolean).hash_code(), typeid(StBoolean).hash_code()});
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_double_double({typeid(StDouble).hash_code(), typeid(StDouble).hash_code()});
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_double_integer({typeid(StDouble).hash_code(), typeid(StInteger).hash_code()});
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_integer_double({typeid(StInteger).hash_code(), typeid(StDouble).hash_code()});
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_integer_integer({typeid(StInteger).hash_code(), typeid(StInteger).hash_code()});
-
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_double_vec3({typeid(StDouble).hash_code(), typeid(StVec3).hash_code()});
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_vec3_double({typeid(StVec3).hash_code(), typeid(StDouble).hash_code()});
-
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_integer_vec3({typeid(StInteger).hash_code(), typeid(StVec3).hash_code()});
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_vec3_integer({typeid(StVec3).hash_code(), typeid(StInteger).hash_code()});
-
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_vec3_vec3({typeid(StVec3).hash_code(), typeid(StVec3).hash_code()});
-
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_string_any({typeid(StString).hash_code(),rpn::StrictTypeValidator::v_anytype});
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_any_string({rpn::StrictTypeValidator::v_anytype,typeid(StString).hash_code()});
-
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_array_any({typeid(StArray).hash_code(), rpn::StrictTypeValidator::v_anytype});
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_any_array({rpn::StrictTypeValidator::v_anytype,typeid(StArray).hash_code()});
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_object_any({typeid(StObject).hash_code(),rpn::StrictTypeValidator::v_anytype});
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_any_object({rpn::StrictTypeValidator::v_anytype,typeid(StObject).hash_code()});
-
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d3_double_double_double({typeid(StDouble).hash_code(),typeid(StDouble).hash_code(),typeid(StDouble).hash_code()});
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d3_integer_double_double({typeid(StInteger).hash_code(),typeid(StDouble).hash_code(),typeid(StDouble).hash_code()});
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d3_double_integer_double({typeid(StDouble).hash_code(),typeid(StInteger).hash_code(),typeid(StDouble).hash_code()});
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d3_double_double_integer({typeid(StDouble).hash_code(),typeid(StDouble).hash_code(),typeid(StInteger).hash_code()});
-
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d3_integer_integer_integer({typeid(StInteger).hash_code(),typeid(StInteger).hash_code(),typeid(StInteger).hash_code()});
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d3_double_integer_integer({typeid(StDouble).hash_code(),typeid(StInteger).hash_code(),typeid(StInteger).hash_code()});
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d3_integer_double_integer({typeid(StInteger).hash_code(),typeid(StDouble).hash_code(),typeid(StInteger).hash_code()});
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d3_integer_integer_double({typeid(StInteger).hash_code(),typeid(StInteger).hash_code(),typeid(StDouble).hash_code()});
-
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d3_object_string_any({typeid(StObject).hash_code(),typeid(StString).hash_code(),rpn::StrictTypeValidator::v_anytype});
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d3_string_any_object({typeid(StString).hash_code(),rpn::StrictTypeValidator::v_anytype,typeid(StObject).hash_code()});
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d3_any_any_boolean({rpn::StrictTypeValidator::v_anytype, rpn::StrictTypeValidator::v_anytype, typeid(StBoolean).hash_code()} );
-
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d4_double_double_double_integer({typeid(StDouble).hash_code(),typeid(StDouble).hash_code(),typeid(StDouble).hash_code(),typeid(StInteger).hash_code()});
-const rpn::StrictTypeValidator rpn::StrictTypeValidator::d4_integer_double_double_double({typeid(StInteger).hash_code(),typeid(StDouble).hash_code(),typeid(StDouble).hash_code(),typeid(StDouble).hash_code()});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d1_double({rpn::Types::t_double});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d1_integer({rpn::Types::t_integer});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d1_boolean({rpn::Types::t_boolean});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d1_string({rpn::Types::t_string});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d1_vec3({rpn::Types::t_vec3});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d1_object({rpn::Types::t_object});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d1_array({rpn::Types::t_array});
+
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_boolean_boolean({rpn::Types::t_boolean, rpn::Types::t_boolean});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_double_double({rpn::Types::t_double, rpn::Types::t_double});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_double_integer({rpn::Types::t_double, rpn::Types::t_integer});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_integer_double({rpn::Types::t_integer, rpn::Types::t_double});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_integer_integer({rpn::Types::t_integer, rpn::Types::t_integer});
+
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_double_vec3({rpn::Types::t_double, rpn::Types::t_vec3});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_vec3_double({rpn::Types::t_vec3, rpn::Types::t_double});
+
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_integer_vec3({rpn::Types::t_integer, rpn::Types::t_vec3});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_vec3_integer({rpn::Types::t_vec3, rpn::Types::t_integer});
+
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_vec3_vec3({rpn::Types::t_vec3, rpn::Types::t_vec3});
+
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_string_any({rpn::Types::t_string,rpn::Types::any});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_any_string({rpn::Types::any,rpn::Types::t_string});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_string_array({rpn::Types::t_string,rpn::Types::t_array});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_string_string({rpn::Types::t_string,rpn::Types::t_string});
+
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_array_any({rpn::Types::t_array, rpn::Types::any});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_any_array({rpn::Types::any,rpn::Types::t_array});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_object_any({rpn::Types::t_object,rpn::Types::any});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d2_any_object({rpn::Types::any,rpn::Types::t_object});
+
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d3_double_double_double({rpn::Types::t_double,rpn::Types::t_double,rpn::Types::t_double});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d3_integer_double_double({rpn::Types::t_integer,rpn::Types::t_double,rpn::Types::t_double});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d3_double_integer_double({rpn::Types::t_double,rpn::Types::t_integer,rpn::Types::t_double});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d3_double_double_integer({rpn::Types::t_double,rpn::Types::t_double,rpn::Types::t_integer});
+
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d3_integer_integer_integer({rpn::Types::t_integer,rpn::Types::t_integer,rpn::Types::t_integer});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d3_double_integer_integer({rpn::Types::t_double,rpn::Types::t_integer,rpn::Types::t_integer});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d3_integer_double_integer({rpn::Types::t_integer,rpn::Types::t_double,rpn::Types::t_integer});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d3_integer_integer_double({rpn::Types::t_integer,rpn::Types::t_integer,rpn::Types::t_double});
+
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d3_object_string_any({rpn::Types::t_object,rpn::Types::t_string,rpn::Types::any});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d3_string_any_object({rpn::Types::t_string,rpn::Types::any,rpn::Types::t_object});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d3_string_any_array({rpn::Types::t_string,rpn::Types::any,rpn::Types::t_array});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d3_any_any_boolean({rpn::Types::any, rpn::Types::any, rpn::Types::t_boolean} );
+
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d4_double_double_double_integer({rpn::Types::t_double,rpn::Types::t_double,rpn::Types::t_double,rpn::Types::t_integer});
+const rpn::StrictTypeValidator rpn::StrictTypeValidator::d4_integer_double_double_double({rpn::Types::t_integer,rpn::Types::t_double,rpn::Types::t_double,rpn::Types::t_double});
 
 const rpn::StackSizeValidator rpn::StackSizeValidator::zero(0);
 const rpn::StackSizeValidator rpn::StackSizeValidator::one(1);
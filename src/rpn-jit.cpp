@@ -0,0 +1,561 @@
+/***************************************************
+ * file: qinc/rpn-lang/src/rpn-jit.cpp
+ *
+ * @file    rpn-jit.cpp
+ * @author  Eric L. Hernes
+ * @born_on   Friday, October 16, 2026
+ * @copyright (C) Copyright Eric L. Hernes 2026
+ * @copyright (C) Copyright Q, Inc. 2026
+ *
+ * @brief   An Eric L. Hernes Signature Series C++ module
+ *
+ */
+
+#define _USE_MATH_DEFINES // for MSVC
+
+#include "rpn-jit.h"
+
+#include <cmath>
+#include <cstring>
+#include <cctype>
+#include <deque>
+#include <algorithm>
+
+#if !defined(_WIN32) && (defined(__x86_64__) || (defined(__aarch64__) && defined(__linux__)))
+#define RPN_JIT_NATIVE 1
+#include <sys/mman.h>
+#endif
+
+/*
+ * the math words again, with the same semantics as math-dict.cpp so that
+ * a native word gives the same answers as an interpreted one
+ */
+static double deg_to_rad(const double &deg) { return deg * (M_PI / 180.); }
+static double rad_to_deg(const double &rad) { return rad * 180. / M_PI; }
+
+static double add(double a, double b) { return a+b; }
+static double subtract(double a, double b) { return a-b; }
+static double multiply(double a, double b) { return a*b; }
+static double divide(double a, double b) { return a/b; }
+static double atan2_deg(double a, double b) { return rad_to_deg(atan2(a,b)); }
+static double jpow(double a, double b) { return pow(a,b); }
+static double jhypot(double a, double b) { return hypot(a,b); }
+static double jfmin(double a, double b) { return fmin(a,b); }
+static double jfmax(double a, double b) { return fmax(a,b); }
+
+static int64_t iadd(int64_t a, int64_t b) { return a+b; }
+static int64_t isubtract(int64_t a, int64_t b) { return a-b; }
+static int64_t imultiply(int64_t a, int64_t b) { return a*b; }
+static int64_t idivide(int64_t a, int64_t b) { return a/b; }
+static int64_t ipow(int64_t a, int64_t b) { return (int64_t)pow(a,b); }
+static int64_t imin(int64_t a, int64_t b) { return std::min(a,b); }
+static int64_t imax(int64_t a, int64_t b) { return std::max(a,b); }
+
+static double inverse(double a) { return 1./a; }
+static double square(double a) { return a*a; }
+static double change_sign(double x) { return -1. * x; }
+static double cos_deg(double a) { return cos(deg_to_rad(a)); }
+static double sin_deg(double a) { return sin(deg_to_rad(a)); }
+static double tan_deg(double a) { return tan(deg_to_rad(a)); }
+static double acos_deg(double a) { return rad_to_deg(acos(a)); }
+static double asin_deg(double a) { return rad_to_deg(asin(a)); }
+static double atan_deg(double a) { return rad_to_deg(atan(a)); }
+static double ln2(double a) { return log(a)/0.69314718056; } // ln(2)
+static double jsqrt(double a) { return sqrt(a); }
+static double jexp(double a) { return exp(a); }
+static double jlog(double a) { return log(a); }
+static double jlog10(double a) { return log10(a); }
+static double jround(double a) { return round(a); }
+static double jceil(double a) { return ceil(a); }
+static double jfloor(double a) { return floor(a); }
+
+static int64_t isquare(int64_t a) { return a*a; }
+static int64_t ichange_sign(int64_t x) { return -1 * x; }
+
+namespace {
+  enum class Op { add, sub, mul, div, sqrt, call1, call2 };
+
+  struct Insn {
+    Op op;
+    unsigned dst, a, b;
+    const void *fn;
+  };
+
+  struct Binary {
+    const char *word;
+    Op op;                              // add..div are inline, call2 for the rest
+    double (*dfn)(double,double);
+    int64_t (*ifn)(int64_t,int64_t);    // nullptr: integers are promoted to double
+  };
+
+  const Binary s_binary[] = {
+    { "+",     Op::add,   add,       iadd },
+    { "-",     Op::sub,   subtract,  isubtract },
+    { "*",     Op::mul,   multiply,  imultiply },
+    { "/",     Op::div,   divide,    idivide },
+    { "^",     Op::call2, jpow,      ipow },
+    { "HYPOT", Op::call2, jhypot,    nullptr },
+    { "ATAN2", Op::call2, atan2_deg, nullptr },
+    { "MIN",   Op::call2, jfmin,     imin },
+    { "MAX",   Op::call2, jfmax,     imax },
+  };
+
+  struct Unary {
+    const char *word;
+    Op op;                     // call1 unless it has an inline form
+    double (*dfn)(double);
+    int64_t (*ifn)(int64_t);   // nullptr: integers are promoted to double
+    bool integers;             // false: there is no integer definition at all
+  };
+
+  const Unary s_unary[] = {
+    { "INV",   Op::div,   inverse,      nullptr,      true },
+    { "SQ",    Op::mul,   square,       isquare,      true },
+    { "CHS",   Op::mul,   change_sign,  ichange_sign, true },
+    { "SQRT",  Op::sqrt,  jsqrt,        nullptr,      true },
+    { "COS",   Op::call1, cos_deg,      nullptr,      true },
+    { "SIN",   Op::call1, sin_deg,      nullptr,      true },
+    { "TAN",   Op::call1, tan_deg,      nullptr,      true },
+    { "ACOS",  Op::call1, acos_deg,     nullptr,      true },
+    { "ASIN",  Op::call1, asin_deg,     nullptr,      true },
+    { "ATAN",  Op::call1, atan_deg,     nullptr,      true },
+    { "EXP",   Op::call1, jexp,         nullptr,      true },
+    { "LN",    Op::call1, jlog,         nullptr,      true },
+    { "LN2",   Op::call1, ln2,          nullptr,      true },
+    { "LOG",   Op::call1, jlog10,       nullptr,      true },
+    { "ROUND", Op::call1, jround,       nullptr,      false },
+    { "CEIL",  Op::call1, jceil,        nullptr,      false },
+    { "FLOOR", Op::call1, jfloor,       nullptr,      false },
+  };
+
+  // a value on the abstract stack
+  struct Val {
+    enum Kind { integer, constant, runtime } kind; // runtime values live in a slot
+    int64_t ival;
+    double dval;
+    unsigned slot;
+  };
+
+  class Builder {
+  public:
+    std::deque<Val> stack;            // back is the top
+    std::vector<unsigned> inputs;     // slots of the entry stack, [0] is the top
+    std::vector<std::pair<std::string,unsigned>> params; // named values and their slots
+    std::vector<double> slots;        // initial slot values
+    std::vector<Insn> code;
+
+    unsigned new_slot(double init=0.) {
+      slots.push_back(init);
+      return (unsigned)slots.size()-1;
+    }
+
+    // make sure the abstract stack has at least n values, the missing
+    // ones are inputs from below
+    void need(size_t n) {
+      while(stack.size() < n) {
+	unsigned s = new_slot();
+	inputs.push_back(s);
+	stack.push_front({ Val::runtime, 0, 0., s });
+      }
+    }
+
+    Val pop() {
+      need(1);
+      Val v = stack.back();
+      stack.pop_back();
+      return v;
+    }
+
+    unsigned in_slot(Val &v) {
+      if (v.kind == Val::integer) {
+	v = { Val::runtime, 0, 0., new_slot((double)v.ival) };
+      } else if (v.kind == Val::constant) {
+	v = { Val::runtime, 0, 0., new_slot(v.dval) };
+      }
+      return v.slot;
+    }
+
+    static bool is_const(const Val &v) { return v.kind != Val::runtime; }
+    static double as_double(const Val &v) { return (v.kind == Val::integer) ? (double)v.ival : v.dval; }
+
+    bool binary(const Binary &b) {
+      Val s1 = pop();
+      Val s2 = pop();
+      if (s1.kind == Val::integer && s2.kind == Val::integer) {
+	if (b.ifn == nullptr) {
+	  stack.push_back({ Val::constant, 0, b.dfn((double)s2.ival, (double)s1.ival), 0 });
+	} else if (b.ifn == idivide && s1.ival == 0) {
+	  return false; // leave that to the interpreter
+	} else {
+	  stack.push_back({ Val::integer, b.ifn(s2.ival, s1.ival), 0., 0 });
+	}
+      } else if (is_const(s1) && is_const(s2)) {
+	stack.push_back({ Val::constant, 0, b.dfn(as_double(s2), as_double(s1)), 0 });
+      } else {
+	unsigned a = in_slot(s2);
+	unsigned c = in_slot(s1);
+	unsigned d = new_slot();
+	code.push_back({ b.op, d, a, c, (b.op == Op::call2) ? (const void*)b.dfn : nullptr });
+	stack.push_back({ Val::runtime, 0, 0., d });
+      }
+      return true;
+    }
+
+    bool unary(const Unary &u) {
+      Val s1 = pop();
+      if (s1.kind == Val::integer) {
+	if (!u.integers) {
+	  return false;
+	} else if (u.ifn) {
+	  stack.push_back({ Val::integer, u.ifn(s1.ival), 0., 0 });
+	} else {
+	  stack.push_back({ Val::constant, 0, u.dfn((double)s1.ival), 0 });
+	}
+      } else if (s1.kind == Val::constant) {
+	stack.push_back({ Val::constant, 0, u.dfn(s1.dval), 0 });
+      } else {
+	unsigned a = in_slot(s1);
+	unsigned d = new_slot();
+	if (u.dfn == inverse) {
+	  code.push_back({ Op::div, d, new_slot(1.), a, nullptr });
+	} else if (u.dfn == square) {
+	  code.push_back({ Op::mul, d, a, a, nullptr });
+	} else if (u.dfn == change_sign) {
+	  code.push_back({ Op::mul, d, new_slot(-1.), a, nullptr });
+	} else {
+	  code.push_back({ u.op, d, a, 0, (u.op == Op::call1) ? (const void*)u.dfn : nullptr });
+	}
+	stack.push_back({ Val::runtime, 0, 0., d });
+      }
+      return true;
+    }
+
+    // the n of DROPn, PICK, ... has to be known here
+    bool count(int &n) {
+      Val v = pop();
+      n = (int)v.ival;
+      return (v.kind == Val::integer && v.ival > 0 && v.ival < 4096);
+    }
+
+    bool word(const std::string &w) {
+      // numbers are parsed the way runtime_eval does it
+      if (std::isdigit(w[0]) || (w[0]=='-' && std::isdigit(w[1]))) {
+	if (w.find('.') != std::string::npos) {
+	  stack.push_back({ Val::constant, 0, strtod(w.c_str(), nullptr), 0 });
+	} else {
+	  stack.push_back({ Val::integer, strtol(w.c_str(), nullptr, 0), 0., 0 });
+	}
+	return true;
+      }
+
+      for(const auto &p : params) {
+	if (w == p.first) {
+	  stack.push_back({ Val::runtime, 0, 0., p.second });
+	  return true;
+	}
+      }
+      for(const auto &b : s_binary) {
+	if (w == b.word) return binary(b);
+      }
+      for(const auto &u : s_unary) {
+	if (w == u.word) return unary(u);
+      }
+
+      int n;
+      if (w == "k_PI") {
+	stack.push_back({ Val::constant, 0, M_PI, 0 });
+      } else if (w == "k_E") {
+	stack.push_back({ Val::constant, 0, M_E, 0 });
+      } else if (w == "DROP") {
+	pop();
+      } else if (w == "DUP") {
+	need(1);
+	stack.push_back(stack.back());
+      } else if (w == "OVER") {
+	need(2);
+	stack.push_back(stack[stack.size()-2]);
+      } else if (w == "SWAP") {
+	need(2);
+	std::swap(stack[stack.size()-1], stack[stack.size()-2]);
+      } else if (w == "ROTU" || w == "ROTD") {
+	need(3);
+	if (w == "ROTU") {
+	  std::rotate(stack.end()-3, stack.end()-2, stack.end());
+	} else {
+	  std::rotate(stack.end()-3, stack.end()-1, stack.end());
+	}
+      } else if (w == "PICK") {
+	if (!count(n)) return false;
+	need(n);
+	stack.push_back(stack[stack.size()-n]);
+      } else if (w == "DROPn") {
+	if (!count(n)) return false;
+	need(n);
+	stack.resize(stack.size()-n);
+      } else if (w == "DUPn") {
+	if (!count(n)) return false;
+	need(n);
+	for(size_t i=stack.size()-n, e=stack.size(); i<e; i++) {
+	  stack.push_back(stack[i]);
+	}
+      } else if (w == "NIPn") {
+	if (!count(n)) return false;
+	need(n);
+	stack.erase(stack.end()-n);
+      } else if (w == "ROLLDn") {
+	if (!count(n)) return false;
+	need(n);
+	std::rotate(stack.end()-n, stack.end()-1, stack.end());
+      } else if (w == "ROLLUn") {
+	if (!count(n)) return false;
+	need(n);
+	std::rotate(stack.end()-n, stack.end()-n+1, stack.end());
+      } else if (w == "TUCKn") {
+	if (!count(n)) return false;
+	need(n);
+	stack.insert(stack.end()-(n-1), stack.back());
+      } else if (w == "REVERSEn") {
+	if (!count(n)) return false;
+	need(n);
+	std::reverse(stack.end()-n, stack.end());
+      } else {
+	return false;
+      }
+      return true;
+    }
+  };
+
+#if defined(RPN_JIT_NATIVE)
+  class Emitter {
+  public:
+    std::vector<uint8_t> buf;
+
+#if defined(__x86_64__)
+    // rdi is the slot array, kept in rbx across calls
+    void byte(uint8_t b) { buf.push_back(b); }
+    void bytes(std::initializer_list<uint8_t> l) { buf.insert(buf.end(), l); }
+    void disp(unsigned slot) {
+      uint32_t d = slot*8;
+      for(int i=0; i<4; i++) byte((uint8_t)(d >> (8*i)));
+    }
+    // F2 0F op ModRM(mod=10 reg=xmm rm=rbx) disp32
+    void sse(uint8_t op, unsigned xmm, unsigned slot) {
+      bytes({ 0xF2, 0x0F, op, (uint8_t)(0x83 | (xmm<<3)) });
+      disp(slot);
+    }
+    void load(unsigned xmm, unsigned slot) { sse(0x10, xmm, slot); }
+    void store(unsigned slot) { sse(0x11, 0, slot); }
+    void call(const void *fn) {
+      uint64_t a = (uint64_t)fn;
+      bytes({ 0x48, 0xB8 }); // mov rax, imm64
+      for(int i=0; i<8; i++) byte((uint8_t)(a >> (8*i)));
+      bytes({ 0xFF, 0xD0 }); // call rax
+    }
+
+    bool prologue() {
+      bytes({ 0x53, 0x48, 0x89, 0xFB }); // push rbx; mov rbx, rdi
+      return true;
+    }
+    bool insn(const Insn &i) {
+      static const uint8_t arith[] = { 0x58, 0x5C, 0x59, 0x5E }; // add sub mul div
+      switch(i.op) {
+      case Op::add: case Op::sub: case Op::mul: case Op::div:
+	load(0, i.a);
+	sse(arith[(int)i.op], 0, i.b);
+	break;
+      case Op::sqrt:
+	sse(0x51, 0, i.a);
+	break;
+      case Op::call1:
+	load(0, i.a);
+	call(i.fn);
+	break;
+      case Op::call2:
+	load(0, i.a);
+	load(1, i.b);
+	call(i.fn);
+	break;
+      }
+      store(i.dst);
+      return true;
+    }
+    void epilogue() {
+      bytes({ 0x5B, 0xC3 }); // pop rbx; ret
+    }
+
+#elif defined(__aarch64__)
+    // x0 is the slot array, kept in x19 across calls
+    void word(uint32_t w) {
+      for(int i=0; i<4; i++) buf.push_back((uint8_t)(w >> (8*i)));
+    }
+    void load(unsigned d, unsigned slot) { word(0xFD400000 | (slot<<10) | (19<<5) | d); } // ldr dN, [x19, #slot*8]
+    void store(unsigned slot) { word(0xFD000000 | (slot<<10) | (19<<5)); }            // str d0, [x19, #slot*8]
+    void call(const void *fn) {
+      uint64_t a = (uint64_t)fn;
+      word(0xD2800010 | (uint32_t)((a & 0xffff) << 5));                      // movz x16, #a
+      for(uint32_t hw=1; hw<4; hw++) {
+	word(0xF2800010 | (hw<<21) | (uint32_t)(((a >> (16*hw)) & 0xffff) << 5)); // movk x16, #a, lsl #16*hw
+      }
+      word(0xD63F0200); // blr x16
+    }
+
+    bool prologue() {
+      word(0xA9BE7BFD); // stp x29, x30, [sp, #-32]!
+      word(0x910003FD); // mov x29, sp
+      word(0xF9000BF3); // str x19, [sp, #16]
+      word(0xAA0003F3); // mov x19, x0
+      return true;
+    }
+    bool insn(const Insn &i) {
+      static const uint32_t arith[] = { 0x2800, 0x3800, 0x0800, 0x1800 }; // fadd fsub fmul fdiv
+      if (i.dst >= 4096 || i.a >= 4096 || i.b >= 4096) {
+	return false; // out of reach of the scaled offset
+      }
+      switch(i.op) {
+      case Op::add: case Op::sub: case Op::mul: case Op::div:
+	load(0, i.a);
+	load(1, i.b);
+	word(0x1E600000 | (1<<16) | arith[(int)i.op]); // fop d0, d0, d1
+	break;
+      case Op::sqrt:
+	load(0, i.a);
+	word(0x1E61C000); // fsqrt d0, d0
+	break;
+      case Op::call1:
+	load(0, i.a);
+	call(i.fn);
+	break;
+      case Op::call2:
+	load(0, i.a);
+	load(1, i.b);
+	call(i.fn);
+	break;
+      }
+      store(i.dst);
+      return true;
+    }
+    void epilogue() {
+      word(0xF9400BF3); // ldr x19, [sp, #16]
+      word(0xA8C27BFD); // ldp x29, x30, [sp], #32
+      word(0xD65F03C0); // ret
+    }
+#endif
+  };
+#endif
+}
+
+std::unique_ptr<rpn::jit::Kernel>
+rpn::jit::Kernel::compile(const std::vector<std::string> &words,
+			  const std::function<bool(const std::string&)> &builtin,
+			  const std::vector<std::string> &params) {
+#if defined(RPN_JIT_NATIVE)
+  Builder b;
+  for(const auto &p : params) {
+    b.params.emplace_back(p, b.new_slot());
+  }
+  for(const auto &w : words) {
+    if (w.size()==0) {
+      return nullptr;
+    }
+    bool named = (std::isdigit(w[0]) || (w[0]=='-' && std::isdigit(w[1])) ||
+		  std::find(params.cbegin(), params.cend(), w) != params.cend());
+    if ((!named && !builtin(w)) || !b.word(w)) {
+      return nullptr;
+    }
+  }
+
+  std::unique_ptr<Kernel> k(new Kernel());
+  k->_inputSlots = b.inputs;
+  for(const auto &p : b.params) {
+    k->_paramSlots.push_back(p.second);
+  }
+  size_t n = b.inputs.size();
+  k->_keepsInputs = (b.stack.size() >= n);
+  for(size_t i=0; k->_keepsInputs && i<n; i++) {
+    const Val &v = b.stack[b.stack.size()-1-i];
+    k->_keepsInputs = (v.kind == Val::runtime && v.slot == b.inputs[i]);
+  }
+  for(auto &v : b.stack) {
+    if (v.kind == Val::integer) {
+      k->_outputs.push_back({ true, v.ival, 0 });
+    } else {
+      k->_outputs.push_back({ false, 0, b.in_slot(v) });
+    }
+  }
+  k->_template = b.slots;
+
+  Emitter e;
+  bool ok = e.prologue();
+  for(auto ii=b.code.cbegin(); ok && ii!=b.code.cend(); ii++) {
+    ok = e.insn(*ii);
+  }
+  if (!ok) {
+    return nullptr;
+  }
+  e.epilogue();
+
+  // W^X: write the code, then flip the page to read/execute
+  void *mem = mmap(nullptr, e.buf.size(), PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) {
+    return nullptr;
+  }
+  memcpy(mem, e.buf.data(), e.buf.size());
+  if (mprotect(mem, e.buf.size(), PROT_READ|PROT_EXEC) != 0) {
+    munmap(mem, e.buf.size());
+    return nullptr;
+  }
+  __builtin___clear_cache((char*)mem, (char*)mem + e.buf.size());
+  k->_code = mem;
+  k->_codeSize = e.buf.size();
+  return k;
+#else
+  return nullptr;
+#endif
+}
+
+rpn::jit::Kernel::~Kernel() {
+#if defined(RPN_JIT_NATIVE)
+  if (_code) {
+    munmap(_code, _codeSize);
+  }
+#endif
+}
+
+bool
+rpn::jit::Kernel::run(rpn::Stack &stack) const {
+  return run(stack, _slots);
+}
+
+bool
+rpn::jit::Kernel::run(rpn::Stack &stack, std::vector<double> &slots, const double *params) const {
+  size_t n = _inputSlots.size();
+  if (stack.depth() < n || (params == nullptr && _paramSlots.size() > 0)) {
+    return false;
+  }
+
+  slots = _template;
+  for(size_t i=0; i<_paramSlots.size(); i++) {
+    slots[_paramSlots[i]] = params[i];
+  }
+  for(size_t i=0; i<n; i++) {
+    auto *dp = dynamic_cast<StDouble*>(&stack.peek((int)i+1));
+    if (dp == nullptr) {
+      return false; // integer (or other) inputs keep the interpreter's semantics
+    }
+    slots[_inputSlots[i]] = (double)dp->val();
+  }
+
+  reinterpret_cast<void(*)(double*)>(_code)(slots.data());
+
+  stack.dropn((int)n);
+  for(const auto &o : _outputs) {
+    if (o.integer) {
+      stack.push_integer(o.ival);
+    } else {
+      stack.push_double(slots[o.slot]);
+    }
+  }
+  return true;
+}
+
+/* end of qinc/rpn-lang/src/rpn-jit.cpp */
@@ -0,0 +1,72 @@
+/***************************************************
+ * file: qinc/rpn-lang/src/rpn-jit.h
+ *
+ * @file    rpn-jit.h
+ * @author  Eric L. Hernes
+ * @born_on   Friday, October 16, 2026
+ * @copyright (C) Copyright Eric L. Hernes 2026
+ * @copyright (C) Copyright Q, Inc. 2026
+ *
+ * @brief   An Eric L. Hernes Signature Series C/C++ header
+ *
+ * Native code for compiled words that only do numeric math and stack
+ * shuffles.  The word list is run through an abstract stack at compile
+ * time: shuffles are resolved to slot renames, integer constants are
+ * folded and what remains is a straight line of double operations that
+ * is emitted as x86-64 or AArch64 machine code.  Anything else (strings,
+ * vec3, loops, user words, ...) is rejected and the word stays
+ * interpreted.
+ *
+ * $Id$
+ */
+
+#pragma once
+
+#include "../rpn.h"
+
+namespace rpn {
+  namespace jit {
+    class Kernel {
+    public:
+      ~Kernel();
+
+      // nullptr if the words can't be compiled natively on this host;
+      // params are names (a loop variable) whose values are passed to run()
+      static std::unique_ptr<Kernel> compile(const std::vector<std::string> &words,
+					     const std::function<bool(const std::string&)> &builtin,
+					     const std::vector<std::string> &params = {});
+
+      // false (with the stack untouched) when the inputs on the stack
+      // aren't all doubles, the caller interprets the word instead
+      bool run(rpn::Stack &stack) const;
+      // the same with the caller's slot array, for running on several threads at once
+      bool run(rpn::Stack &stack, std::vector<double> &slots, const double *params=nullptr) const;
+
+      size_t inputs() const { return _inputSlots.size(); }
+      size_t outputs() const { return _outputs.size(); }
+      // the top inputs() outputs are the inputs, as they were
+      bool keeps_inputs() const { return _keepsInputs; }
+
+    private:
+      Kernel() = default;
+
+      struct Output {
+	bool integer;
+	int64_t ival;
+	unsigned slot;
+      };
+
+      std::vector<unsigned> _inputSlots; // [0] is the top of stack at entry
+      std::vector<unsigned> _paramSlots;
+      bool _keepsInputs = false;
+      std::vector<Output> _outputs;      // bottom to top
+      std::vector<double> _template;     // constants prefilled in the slot array
+      mutable std::vector<double> _slots;
+
+      void *_code = nullptr;
+      size_t _codeSize = 0;
+    };
+  }
+}
+
+/* end of qinc/rpn-lang/src/rpn-jit.h */
@@ -0,0 +1,183 @@
+/***************************************************
+ * file: qinc/rpn-lang/src/rpn-output.cpp
+ *
+ * @file    rpn-output.cpp
+ * @author  Eric L. Hernes
+ * @born_on   Friday, October 16, 2026
+ * @copyright (C) Copyright Eric L. Hernes 2026
+ * @copyright (C) Copyright Q, Inc. 2026
+ *
+ * @brief   An Eric L. Hernes Signature Series C++ module
+ *
+ * Output channel, see OutputChannel in rpn.h.
+ *
+ * A record is a u32 length and the bytes, padded to 4.  One that won't
+ * fit before the end of the ring starts over at the front, behind a
+ * length of 'wrap' when there is room for one (there always is, being
+ * padded).  Records are at most half the ring, so once the reader has
+ * caught up any of them fits.  _head and _tail only grow; the writer
+ * publishes a record by moving _head, the reader hands its space back
+ * by moving _tail.
+ */
+
+#include "../rpn.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+  constexpr size_t padded(size_t n) { return (n + 3) & ~size_t(3); }
+}
+
+rpn::OutputChannel::OutputChannel(size_t capacity) : _ring(padded(std::max<size_t>(capacity, 64))) {
+  _batch.reserve(256);
+}
+
+/*
+ * writer
+ */
+bool
+rpn::OutputChannel::try_write(std::string_view rec) {
+  if (rec.size() > max_record()) {
+    return false;
+  }
+  size_t cap = _ring.size();
+  size_t need = padded(header + rec.size());
+  size_t head = _head.load(std::memory_order_relaxed);
+  size_t pos = head % cap;
+  size_t gap = cap - pos;
+  size_t skip = (need > gap) ? gap : 0;
+  if (head - _tail.load(std::memory_order_acquire) + skip + need > cap) {
+    _full++;
+    return false;
+  }
+  if (skip) {
+    std::memcpy(&_ring[pos], &wrap, header);
+    head += skip;
+    pos = 0;
+  }
+  uint32_t len = (uint32_t)rec.size();
+  std::memcpy(&_ring[pos], &len, header);
+  std::memcpy(&_ring[pos + header], rec.data(), rec.size());
+  _head.store(head + need);
+
+  _records.fetch_add(1, std::memory_order_relaxed);
+  _bytes.fetch_add(rec.size(), std::memory_order_relaxed);
+  size_t u = used();
+  if (u > _highWater.load(std::memory_order_relaxed)) {
+    _highWater.store(u, std::memory_order_relaxed);
+  }
+  if (_readerWaits.load()) {
+    std::lock_guard lg(_mx);
+    _cv.notify_all();
+  }
+  return true;
+}
+
+bool
+rpn::OutputChannel::wait_room(size_t n, std::chrono::milliseconds timeout) {
+  // room for it even if it has to wrap
+  size_t need = 2 * padded(header + n);
+  std::unique_lock ul(_mx);
+  uint64_t wakes = _wakes;
+  _writerWaits = true;
+  bool rv = _cv.wait_for(ul, timeout, [&]{ return used() == 0 || _ring.size() - used() >= need || _wakes != wakes; });
+  _writerWaits = false;
+  return rv;
+}
+
+/*
+ * reader
+ */
+size_t
+rpn::OutputChannel::drain(const std::function<void(const Batch &)> &handler, size_t max) {
+  size_t cap = _ring.size();
+  size_t head = _head.load();
+  size_t tail = _tail.load(std::memory_order_relaxed);
+  _batch.clear();
+  while(tail != head && _batch.size() < max) {
+    size_t pos = tail % cap;
+    uint32_t len;
+    std::memcpy(&len, &_ring[pos], header);
+    if (len == wrap) {
+      tail += cap - pos;
+      continue;
+    }
+    _batch.emplace_back(&_ring[pos + header], len);
+    tail += padded(header + len);
+  }
+  size_t rv = _batch.size();
+  if (rv) {
+    handler(_batch);
+    _batches.fetch_add(1, std::memory_order_relaxed);
+  }
+  _batch.clear();
+  _tail.store(tail);
+  if (_writerWaits.load()) {
+    std::lock_guard lg(_mx);
+    _cv.notify_all();
+  }
+  return rv;
+}
+
+bool
+rpn::OutputChannel::wait_data(std::chrono::milliseconds timeout) {
+  std::unique_lock ul(_mx);
+  uint64_t wakes = _wakes;
+  _readerWaits = true;
+  bool rv = _cv.wait_for(ul, timeout, [&]{ return used() != 0 || _wakes != wakes; });
+  _readerWaits = false;
+  return rv && used() != 0;
+}
+
+void
+rpn::OutputChannel::wake() {
+  std::lock_guard lg(_mx);
+  _wakes++;
+  _cv.notify_all();
+}
+
+rpn::OutputChannel::Stats
+rpn::OutputChannel::stats() const {
+  Stats rv;
+  rv.records = _records;
+  rv.bytes = _bytes;
+  rv.batches = _batches;
+  rv.full = _full;
+  rv.high_water = _highWater;
+  return rv;
+}
+
+/*
+ * stand-in sink
+ */
+void
+rpn::MemorySink::write(const OutputChannel::Batch &records) {
+  std::lock_guard lg(_mx);
+  for(auto const &r : records) {
+    _records.emplace_back(r);
+  }
+  _batches++;
+  _cv.notify_all();
+}
+
+std::vector<std::string>
+rpn::MemorySink::records() {
+  std::lock_guard lg(_mx);
+  return _records;
+}
+
+uint64_t
+rpn::MemorySink::batches() {
+  std::lock_guard lg(_mx);
+  return _batches;
+}
+
+bool
+rpn::MemorySink::wait_for(size_t n, std::chrono::milliseconds timeout) {
+  std::unique_lock ul(_mx);
+  return _cv.wait_for(ul, timeout, [&]{ return _records.size() >= n; });
+}
+
+/* end of qinc/rpn-lang/src/rpn-output.cpp */
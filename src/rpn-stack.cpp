@@ -14,27 +14,330 @@
 
 #include "../rpn.h"
 
+#include <algorithm>
 #include <cmath>
+#include <mutex>
+#include <typeindex>
 #include <typeinfo>
+#include <unordered_map>
+
+/*
+ * type registry
+ *
+ * ids are handed out in order, the built-ins are registered first so
+ * that they get the constants in rpn::Types.
+ */
+namespace {
+  struct TypeRegistry {
+    std::mutex lock;
+    std::unordered_map<std::type_index, rpn::TypeId> ids;
+    std::vector<std::string> names;
+
+    TypeRegistry() : names({ "none" }) {
+      enter(typeid(rpn::Stack::Object), "any");
+      enter(typeid(StDouble), "double");
+      enter(typeid(StInteger), "integer");
+      enter(typeid(StBoolean), "boolean");
+      enter(typeid(StString), "string");
+      enter(typeid(StObject), "object");
+      enter(typeid(StArray), "array");
+      enter(typeid(StVec3), "vec3");
+    }
+
+    rpn::TypeId enter(const std::type_info &type, const std::string &name) {
+      if (names.size() > UINT16_MAX) {
+	throw std::runtime_error("too many stack object types");
+      }
+      rpn::TypeId id = (rpn::TypeId)names.size();
+      names.push_back(name);
+      ids.emplace(type, id);
+      return id;
+    }
+  };
+
+  TypeRegistry &registry() {
+    static TypeRegistry r;
+    return r;
+  }
+}
+
+rpn::TypeId
+rpn::Types::id(const std::type_info &type) {
+  auto &r = registry();
+  std::lock_guard<std::mutex> lock(r.lock);
+  auto ti = r.ids.find(type);
+  return (ti != r.ids.end()) ? ti->second : r.enter(type, type.name());
+}
+
+rpn::TypeId
+rpn::Types::add(const std::type_info &type, const std::string &name) {
+  auto &r = registry();
+  std::lock_guard<std::mutex> lock(r.lock);
+  auto ti = r.ids.find(type);
+  if (ti != r.ids.end()) {
+    r.names[ti->second] = name;
+    return ti->second;
+  }
+  return r.enter(type, name);
+}
+
+std::string
+rpn::Types::name(TypeId id) {
+  auto &r = registry();
+  std::lock_guard<std::mutex> lock(r.lock);
+  return (id < r.names.size()) ? r.names[id] : "?";
+}
+
+// the object as a T, compared by id instead of dynamic_cast
+template<typename T>
+static T *typed(rpn::Stack::Object *ob, rpn::TypeId id) {
+  return (ob != nullptr && ob->type_id() == id) ? static_cast<T*>(ob) : nullptr;
+}
+
+// throws bad_cast like dynamic_cast to a reference does
+template<typename T>
+static const T &typed(const rpn::Stack::Object &ob, rpn::TypeId id) {
+  if (ob.type_id() != id) {
+    throw std::bad_cast();
+  }
+  return static_cast<const T&>(ob);
+}
+
+rpn::Stack::Stack() : _dirty((size_t)-1), _current(0), _changed((size_t)-1), _historyLimit(4096) {
+  _published = std::make_shared<const Snapshot>(Snapshot{0, {}, {}, ""});
+  _history.push_back(State { 0, 0, {} });
+}
+
+/*
+ * snapshot publication
+ *
+ * Mutating primitives call touch() with the number of slots (from the
+ * top) they modified.  publish() re-stringifies only those slots and
+ * copies the strings below them from the previous snapshot (so a publish
+ * is still O(depth), the saving is in to_string()), then swaps the
+ * snapshot pointer atomically so readers never see the live stack.  The
+ * status goes in the same snapshot, a reader gets the pair consistently.
+ */
+void
+rpn::Stack::touch(size_t n) {
+  size_t idx = (_stack.size() > n) ? _stack.size()-n : 0;
+  _dirty = std::min(_dirty, idx);
+  _changed = std::min(_changed, idx);
+}
+
+uint64_t
+rpn::Stack::publish(const std::string &status) {
+  auto prev = snapshot();
+  if (_dirty == (size_t)-1 && status == prev->status) {
+    return prev->version;
+  }
+
+  auto next = std::make_shared<Snapshot>();
+  next->version = prev->version+1;
+  next->status = status;
+  size_t keep = std::min(_dirty, std::min(prev->items.size(), _stack.size()));
+  next->items.assign(prev->items.begin(), prev->items.begin()+keep);
+  next->changed.assign(prev->changed.begin(), prev->changed.begin()+keep);
+  for(size_t i=keep; i<_stack.size(); i++) {
+    next->items.push_back(_stack[i]->to_string());
+    next->changed.push_back(next->version);
+  }
+  _dirty = (size_t)-1;
+
+  std::shared_ptr<const Snapshot> published(std::move(next));
+  std::atomic_store(&_published, published);
+  if (_observer) {
+    _observer(published);
+  }
+  return published->version;
+}
+
+std::shared_ptr<const rpn::Stack::Snapshot>
+rpn::Stack::snapshot() const {
+  return std::atomic_load(&_published);
+}
+
+void
+rpn::Stack::observe(const Observer &observer) {
+  _observer = observer;
+}
+
+/*
+ * undo history
+ *
+ * touch() also tracks the lowest slot changed since the last
+ * checkpoint, so a checkpoint copies only the slots from there up and
+ * undo/redo only rebuild those: both are proportional to what the
+ * command changed, not to the depth of the stack.
+ */
+void
+rpn::Stack::checkpoint() {
+  if (_changed == (size_t)-1) {
+    return;
+  }
+  State state { _stack.size(), std::min({ _changed, _stack.size(), _history[_current].depth }), {} };
+  for(size_t i=state.base; i<state.depth; i++) {
+    state.slots.push_back(_stack[i]->deep_copy());
+    state.bytes += state.slots.back()->footprint();
+  }
+  size_t hb = history_bytes() + state.bytes;
+  for(size_t i=_current+1; i<_history.size(); i++) {
+    hb -= _history[i].bytes;
+  }
+  _history.resize(_current+1); // a change after undo drops the redo states
+  _history.push_back(std::move(state));
+  _current++;
+  _changed = (size_t)-1;
+  _historyBytes.store(hb, std::memory_order_relaxed);
+
+  while(_history.size() > _historyLimit && _history.size() > 1) {
+    drop_oldest();
+  }
+}
+
+void
+rpn::Stack::drop_oldest() {
+  // the next state takes over the slots it shared with the oldest one
+  State &oldest = _history[0];
+  State &next = _history[1];
+  for(size_t i=0; i<next.base; i++) {
+    size_t b = oldest.slots[i]->footprint();
+    oldest.bytes -= b;
+    next.bytes += b;
+  }
+  next.slots.insert(next.slots.begin(), std::make_move_iterator(oldest.slots.begin()),
+		    std::make_move_iterator(oldest.slots.begin() + next.base));
+  next.base = 0;
+  _historyBytes.store(history_bytes() - oldest.bytes, std::memory_order_relaxed);
+  _history.pop_front();
+  _current--;
+}
+
+bool
+rpn::Stack::trim_history() {
+  if (_current+1 < _history.size()) {
+    size_t hb = history_bytes();
+    for(size_t i=_current+1; i<_history.size(); i++) {
+      hb -= _history[i].bytes;
+    }
+    _history.resize(_current+1);
+    _historyBytes.store(hb, std::memory_order_relaxed);
+  } else if (_current > 0) {
+    drop_oldest();
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const rpn::Stack::Object &
+rpn::Stack::state_item(size_t state, size_t i) const {
+  while(i < _history[state].base) {
+    state--;
+  }
+  return *_history[state].slots[i - _history[state].base];
+}
+
+void
+rpn::Stack::restore(size_t state, size_t from) {
+  from = std::min({ from, _stack.size(), _history[state].depth });
+  for(size_t i=from; i<_stack.size(); i++) {
+    sub_bytes(_stack[i]->footprint());
+  }
+  _stack.resize(from);
+  for(size_t i=from; i<_history[state].depth; i++) {
+    _stack.push_back(state_item(state, i).deep_copy());
+    add_bytes(_stack.back()->footprint());
+  }
+  _current = state;
+  _changed = (size_t)-1;
+  _dirty = std::min(_dirty, from);
+}
+
+void
+rpn::Stack::rollback() {
+  if (_changed != (size_t)-1) {
+    restore(_current, _changed);
+  }
+}
+
+bool
+rpn::Stack::undo() {
+  checkpoint(); // changes since the last one can be redone
+  if (_current == 0) {
+    return false;
+  }
+  // the slots under the current state's base are the same in the previous one
+  restore(_current-1, _history[_current].base);
+  return true;
+}
+
+bool
+rpn::Stack::redo() {
+  checkpoint();
+  if (_current+1 >= _history.size()) {
+    return false;
+  }
+  restore(_current+1, _history[_current+1].base);
+  return true;
+}
+
+size_t
+rpn::Stack::undo_levels() const {
+  return _current;
+}
+
+size_t
+rpn::Stack::redo_levels() const {
+  return _history.size() - _current - 1;
+}
+
+void
+rpn::Stack::history_limit(size_t n) {
+  _historyLimit = std::max(n, (size_t)1);
+}
+
+size_t
+rpn::Stack::Snapshot::dirty_from(uint64_t since) const {
+  size_t rv = 0;
+  for(; rv<changed.size() && changed[rv]<=since; rv++);
+  return rv;
+}
 
 /*
  * primitives for stack operations
+ *
+ * the stack is a contiguous vector with the top at the end, so peek(n)
+ * is an index and the rolls/picks only move the top n pointers.
  */
 
-std::vector<size_t>
+std::vector<rpn::TypeId>
 rpn::Stack::types() const {
-  std::vector<size_t> types;
-  for(auto const &v : _stack) {
-    auto &vt = *v;
-    types.push_back(typeid(vt).hash_code());
+  std::vector<TypeId> types;
+  for(auto v=_stack.crbegin(); v!=_stack.crend(); v++) {
+    types.push_back((*v)->type_id());
   }
   return types;
 }
 
+rpn::TypeId
+rpn::Stack::type(int n) const {
+  return (n>0 && _stack.size()>=(size_t)n) ? _stack[_stack.size()-n]->type_id() : Types::none;
+}
+
 void
 rpn::Stack::push(const Object &ob) {
   std::unique_ptr<Object> ptr = ob.deep_copy();
-  _stack.push_front(std::move(ptr));
+  add_bytes(ptr->footprint());
+  _stack.push_back(std::move(ptr));
+  touch(1);
+}
+
+void
+rpn::Stack::push(std::unique_ptr<Object> ob) {
+  add_bytes(ob->footprint());
+  _stack.push_back(std::move(ob));
+  touch(1);
 }
 
 void
@@ -61,8 +364,10 @@ std::unique_ptr<rpn::Stack::Object>
 rpn::Stack::pop() {
   std::unique_ptr<Object> rv(nullptr);
   if (_stack.size()>0) {
-    rv = std::move(_stack.front());
-    _stack.pop_front();
+    rv = std::move(_stack.back());
+    _stack.pop_back();
+    sub_bytes(rv->footprint());
+    touch(0);
   }
   return rv;
 }
@@ -70,9 +375,9 @@ rpn::Stack::pop() {
 bool
 rpn::Stack::pop_boolean() {
   auto tos = pop();
-  auto *typed = dynamic_cast<StBoolean*>(tos.get());
-  if (typed) {
-    return typed->val();
+  auto *bp = typed<StBoolean>(tos.get(), Types::t_boolean);
+  if (bp) {
+    return bp->val();
   }
   throw std::runtime_error("top of stack not boolean");
 }
@@ -80,9 +385,9 @@ rpn::Stack::pop_boolean() {
 std::string
 rpn::Stack::pop_string() {
   auto tos = pop();
-  auto *typed = dynamic_cast<StString*>(tos.get());
-  if (typed) {
-    return typed->val();
+  auto *sp = typed<StString>(tos.get(), Types::t_string);
+  if (sp) {
+    return sp->val();
   }
   throw std::runtime_error("top of stack not string");
 }
@@ -90,16 +395,12 @@ rpn::Stack::pop_string() {
 int64_t
 rpn::Stack::pop_integer() {
   auto tos = pop();
-  auto *typed = dynamic_cast<StInteger*>(tos.get());
-  if (typed) {
-    return typed->val();
+  auto *ip = typed<StInteger>(tos.get(), Types::t_integer);
+  if (ip) {
+    return ip->val();
   }
-  auto h1 =typeid(tos.get()).hash_code();
-  auto h2 = typeid(StInteger*).hash_code();
-  std::string msg("top of stack not double (tos ");
-  msg += std::to_string(h1);
-  msg += ") (needed ";
-  msg += std::to_string(h2);
+  std::string msg("top of stack not integer (tos ");
+  msg += (tos) ? Types::name(tos->type_id()) : "empty";
   msg += ")";
   throw std::runtime_error(msg);
 }
@@ -107,16 +408,12 @@ rpn::Stack::pop_integer() {
 double
 rpn::Stack::pop_double() {
   auto tos = pop();
-  auto *typed = dynamic_cast<StDouble*>(tos.get());
-  if (typed) {
-    return typed->val();
+  auto *dp = typed<StDouble>(tos.get(), Types::t_double);
+  if (dp) {
+    return dp->val();
   }
-  auto h1 =typeid(tos.get()).hash_code();
-  auto h2 = typeid(StDouble*).hash_code();
   std::string msg("top of stack not double (tos ");
-  msg += std::to_string(h1);
-  msg += ") (needed ";
-  msg += std::to_string(h2);
+  msg += (tos) ? Types::name(tos->type_id()) : "empty";
   msg += ")";
   throw std::runtime_error(msg);
 }
@@ -126,8 +423,8 @@ rpn::Stack::pop_as_double() {
   auto tos = pop();
   auto raw = tos.get();
   double val = std::nan("");
-  auto *dp = dynamic_cast<StDouble*>(raw);
-  auto *ip = dynamic_cast<StInteger*>(raw);
+  auto *dp = typed<StDouble>(raw, Types::t_double);
+  auto *ip = typed<StInteger>(raw, Types::t_integer);
   if (dp) {
     val = dp->val();
   } else if (ip) {
@@ -142,10 +439,10 @@ rpn::Stack::pop_as_boolean() {
   auto raw = tos.get();
   bool val=false;
 
-  auto *bp = dynamic_cast<StBoolean*>(raw);
-  auto *sp = dynamic_cast<StString*>(raw);
-  auto *dp = dynamic_cast<StDouble*>(raw);
-  auto *ip = dynamic_cast<StInteger*>(raw);
+  auto *bp = typed<StBoolean>(raw, Types::t_boolean);
+  auto *sp = typed<StString>(raw, Types::t_string);
+  auto *dp = typed<StDouble>(raw, Types::t_double);
+  auto *ip = typed<StInteger>(raw, Types::t_integer);
 
   if (bp) {
     val = bp->val();
@@ -167,7 +464,7 @@ rpn::Stack::pop_as_boolean() {
 rpn::Stack::Object &
 rpn::Stack::peek(int n) {
   if(n>0 && _stack.size()>=n) {
-    return **(_stack.begin()+n-1);
+    return *_stack[_stack.size()-n];
   } else {
     std::string err = "peek: invalid paramaters (n ";
     err += std::to_string(n) + ") (depth " + std::to_string(_stack.size()) + ")";
@@ -175,15 +472,22 @@ rpn::Stack::peek(int n) {
   }
 }
 
+rpn::Stack::Object &
+rpn::Stack::poke(int n) {
+  auto &rv = peek(n);
+  touch(n);
+  return rv;
+}
+
 bool
 rpn::Stack::peek_boolean(int n) {
-  auto const &sv = dynamic_cast<const StBoolean&>(peek(n));
+  auto const &sv = typed<StBoolean>(peek(n), Types::t_boolean);
   return sv.val();
 }
 
 std::string
 rpn::Stack::peek_string(int n) {
-  auto const &sv = dynamic_cast<const StString&>(peek(n));
+  auto const &sv = typed<StString>(peek(n), Types::t_string);
   return sv.val();
 }
 
@@ -195,13 +499,13 @@ rpn::Stack::peek_as_string(int n) {
 
 int64_t
 rpn::Stack::peek_integer(int n) {
-  auto const &sv = dynamic_cast<const StInteger&>(peek(n));
+  auto const &sv = typed<StInteger>(peek(n), Types::t_integer);
   return sv.val();
 }
 
 double
 rpn::Stack::peek_double(int n) {
-  auto const &sv = dynamic_cast<const StDouble&>(peek(n));
+  auto const &sv = typed<StDouble>(peek(n), Types::t_double);
   return sv.val();
 }
 
@@ -209,8 +513,8 @@ double
 rpn::Stack::peek_as_double(int n) {
   auto &raw = peek(n);
   double val = std::nan("");
-  auto dp = dynamic_cast<const StDouble*>(&raw);
-  auto ip = dynamic_cast<const StInteger*>(&raw);
+  auto dp = typed<StDouble>(&raw, Types::t_double);
+  auto ip = typed<StInteger>(&raw, Types::t_integer);
   if (dp) {
     val = dp->val();
   } else if (ip) {
@@ -219,25 +523,40 @@ rpn::Stack::peek_as_double(int n) {
   return val;
 }
 
+void
+rpn::Stack::reserve(size_t n) {
+  _stack.reserve(n);
+}
+
 void
 rpn::Stack::clear() {
   _stack.clear();
+  _bytes = 0;
+  _dirty = 0;
+  _changed = 0;
 }
 
 void
 rpn::Stack::dropn(int n) {
   if (_stack.size()>=n) {
-    _stack.erase(_stack.begin(), _stack.begin()+n);
+    for(size_t i=_stack.size()-n; i<_stack.size(); i++) {
+      sub_bytes(_stack[i]->footprint());
+    }
+    _stack.resize(_stack.size()-n);
+    touch(0);
   }
 }
 
 void
 rpn::Stack::dupn(int n) {
   if (_stack.size()>=n) {
-    for(int i = n; i; i--) {
-      std::unique_ptr<Object> ptr = (*(_stack.begin()+(n-1)))->deep_copy();
-      _stack.push_front(std::move(ptr));
+    size_t base = _stack.size()-n;
+    _stack.reserve(_stack.size()+n);
+    for(size_t i=base; i<base+n; i++) {
+      _stack.push_back(_stack[i]->deep_copy());
+      add_bytes(_stack.back()->footprint());
     }
+    touch(n);
   } else {
     // handle error
     printf("%s: (size %lu) (n %d)\n", __func__, _stack.size(), n);
@@ -246,8 +565,10 @@ rpn::Stack::dupn(int n) {
 
 void
 rpn::Stack::nipn(int n) {
-  if (_stack.size()>=n) {
-    _stack.erase(_stack.begin()+(n-1));
+  if (n>0 && _stack.size()>=n) {
+    sub_bytes(_stack[_stack.size()-n]->footprint());
+    _stack.erase(_stack.end()-n);
+    touch(n-1);
   } else {
     // handle error
     printf("%s: (size %lu) (n %d)\n", __func__, _stack.size(), n);
@@ -257,8 +578,9 @@ rpn::Stack::nipn(int n) {
 void
 rpn::Stack::pick(int n) {
   if (n>0 && _stack.size()>=n) {
-    std::unique_ptr<Object> ptr = (*(_stack.begin()+(n-1)))->deep_copy();
-    _stack.push_front(std::move(ptr));
+    _stack.push_back(_stack[_stack.size()-n]->deep_copy());
+    add_bytes(_stack.back()->footprint());
+    touch(1);
   } else {
     // throw error?
   }
@@ -267,22 +589,25 @@ rpn::Stack::pick(int n) {
 void
 rpn::Stack::reversen(int n) {
   if (n>0 && n<=_stack.size()) {
-    std::reverse(_stack.begin(), _stack.begin()+(n));
+    std::reverse(_stack.end()-n, _stack.end());
+    touch(n);
   }
 }
 
 void
 rpn::Stack::reverse() {
   std::reverse(_stack.begin(), _stack.end());
+  touch(_stack.size());
 }
 
+/*
+ * the rolls are rotations of the top n (contiguous) slots
+ */
 void
 rpn::Stack::rolldn(int n) {
   if (n>0 && n<=_stack.size()) {
-    auto i = _stack.begin();
-    auto ptr = std::move(*i);
-    _stack.erase(i);
-    _stack.insert(_stack.begin()+(n-1), std::move(ptr));
+    std::rotate(_stack.end()-n, _stack.end()-1, _stack.end());
+    touch(n);
   } else {
     // handle error
   }
@@ -291,10 +616,8 @@ rpn::Stack::rolldn(int n) {
 void
 rpn::Stack::rollun(int n) {
   if (n>0 && n<=_stack.size()) {
-    auto i = (_stack.begin()+(n-1));
-    auto ptr = std::move(*i);
-    _stack.erase(i);
-    _stack.push_front(std::move(ptr));
+    std::rotate(_stack.end()-n, _stack.end()-n+1, _stack.end());
+    touch(n);
   } else {
     // handle error
   }
@@ -303,8 +626,10 @@ rpn::Stack::rollun(int n) {
 void
 rpn::Stack::tuckn(int n) {
   if (n>0 && n<=_stack.size()) {
-    auto ptr = (*_stack.begin())->deep_copy();
-    _stack.insert(_stack.begin()+(n-1), std::move(ptr));
+    auto ptr = _stack.back()->deep_copy();
+    add_bytes(ptr->footprint());
+    _stack.insert(_stack.end()-(n-1), std::move(ptr));
+    touch(n);
   } else {
     // handle error
   }
@@ -313,14 +638,17 @@ rpn::Stack::tuckn(int n) {
 void
 rpn::Stack::swap() {
   if (_stack.size()>1) {
-    std::swap(*_stack.begin(), *(_stack.begin()+1));
+    std::swap(_stack[_stack.size()-1], _stack[_stack.size()-2]);
+    touch(2);
   }
 }
 
 void
 rpn::Stack::drop() {
   if (_stack.size()>0) {
-    _stack.pop_front();
+    sub_bytes(_stack.back()->footprint());
+    _stack.pop_back();
+    touch(0);
   }
 }
 
@@ -365,16 +693,14 @@ rpn::Stack::print(const std::string &msg) {
   int padlen = 66-(int)msg.size();
   printf("+---- %02zu -- %s %*.*s+\n", _stack.size(), msg.c_str(), padlen, padlen, padding);
   size_t n = _stack.size();
-  for(auto i=_stack.rbegin(); i!=_stack.rend(); i++, n--) {
+  for(auto i=_stack.begin(); i!=_stack.end(); i++, n--) {
     auto &r = **i; // https://stackoverflow.com/questions/46494928/clang-warning-on-expression-side-effects
-    char hc[32];
-    snprintf(hc, sizeof(hc), "%08lx", typeid(r).hash_code());
-    std::string type = typeid(r).name();
-    if (type.size() > 30) {
-      type.erase(30);
+    std::string type = Types::name(r.type_id());
+    if (type.size() > 26) {
+      type.erase(26);
     }
     type += ":";
-    type += hc;
+    type += std::to_string(r.type_id());
     std::string strval = (*i)->to_string();
     if (strval.size() > 40) {
       strval.erase(37);
@@ -16,372 +16,320 @@
 //
 //  --- ---
 //  YOUR-CONTENT uses the following materials.
-//  (1) Wikipedia article [Shunting-yard algorithm](https://en.wikipedia.org/wiki/Shunting-yard_algorithm), 
+//  (1) Wikipedia article [Shunting-yard algorithm](https://en.wikipedia.org/wiki/Shunting-yard_algorithm),
 //  which is released under the [Creative Commons Attribution-Share-Alike License 3.0](https://creativecommons.org/licenses/by-sa/3.0/).
 //  (2) [Implementation notes for unary operators in Shunting-Yard algorithm](https://stackoverflow.com/a/5240912) by Austin Taylor
 //  which is released under the [Creative Commons Attribution-Share-Alike License 2.5](https://creativecommons.org/licenses/by-sa/2.5/).
 //  --- ---
 //
-#include <iostream>
-#include <sstream>
-#include <string>
-#include <vector>
-#include <deque>
-#include <tuple>
-#include <stdio.h>
-#include <math.h>
-
-static const char* reportFmt = "|%-5s|%-32s|%17s| %s\n";
-
-class Token {
-public:
+/*
+ * Translates algebraic (infix) expressions into rpn words for EVAL.
+ *
+ *   ma = (p2y - p1y) / (p2x - p1x)    =>  p2y p1y - p2x p1x - /   (assign: ma)
+ *   hypot(dx, -dy) * 2                =>  dx dy CHS HYPOT 2 *
+ *
+ * Identifiers are emitted as-is and resolved when the program runs
+ * (locals, variables, then the dictionary).  An identifier followed by
+ * '(' is a function call, it is emitted as the upper-cased dictionary
+ * word after its arguments (cos -> COS, atan2 -> ATAN2).
+ */
+
+#include "../rpn.h"
+
+#include <cctype>
+#include <cstring>
+
+namespace {
+  struct Token {
     enum class Type {
-        Unknown,
-        Number,
-        Operator,
-        LeftParen,
-        RightParen,
+      Number,
+      Identifier,
+      Function,
+      Operator,
+      LeftParen,
+      RightParen,
+      Comma,
     };
 
-    Token(Type type,
-          const std::string& s,
-          int precedence = -1,
-          bool rightAssociative = false,
-          bool unary = false
-    )
-        : type { type }
-        , str ( s )
-        , precedence { precedence }
-        , rightAssociative { rightAssociative }
-        , unary { unary }
-    {}
-
-    const Type type;
-    const std::string str;
-    const int precedence;
-    const bool rightAssociative;
-    const bool unary;
-};
-
-std::ostream& operator<<(std::ostream& os, const Token& token) {
-    os << token.str;
-    return os;
-}
-
-
-// Debug output
-template<class T, class U>
-void debugReport(
-      const Token& token
-    , const T& queue
-    , const U& stack
-    , const std::string& comment = ""
-) {
-    std::ostringstream ossQueue;
-    for(const auto& t : queue) {
-        ossQueue << " " << t;
+    Type type;
+    std::string str; // rpn word for operators and functions
+    int precedence;
+    bool rightAssociative;
+    bool unary;
+  };
+
+  struct OpInfo {
+    const char *sym;
+    const char *word;
+    int precedence;
+    bool rightAssociative;
+  };
+
+  // longest symbols first so that "<=" wins over "<"
+  const OpInfo s_operators[] = {
+    { "==", "==", 1, false },
+    { "!=", "!=", 1, false },
+    { "<=", "<=", 1, false },
+    { ">=", ">=", 1, false },
+    { "<",  "<",  1, false },
+    { ">",  ">",  1, false },
+    { "+",  "+",  2, false },
+    { "-",  "-",  2, false },
+    { "*",  "*",  3, false },
+    { "/",  "/",  3, false },
+    { "^",  "^",  5, true },
+  };
+  const int s_unaryPrecedence = 4; // binds looser than '^': -2^2 == -4
+
+  // arguments taken by the math words, other words take what they're given
+  struct FnInfo {
+    const char *word;
+    size_t args;
+  };
+  const FnInfo s_functions[] = {
+    { "HYPOT", 2 }, { "ATAN2", 2 }, { "MIN", 2 }, { "MAX", 2 },
+    { "INV", 1 }, { "SQ", 1 }, { "SQRT", 1 }, { "CHS", 1 },
+    { "COS", 1 }, { "SIN", 1 }, { "TAN", 1 }, { "ACOS", 1 }, { "ASIN", 1 }, { "ATAN", 1 },
+    { "EXP", 1 }, { "LN", 1 }, { "LN2", 1 }, { "LOG", 1 },
+    { "ROUND", 1 }, { "CEIL", 1 }, { "FLOOR", 1 },
+    { "RAND", 0 }, { "DRAND", 0 },
+  };
+
+  bool is_ident_start(char c) { return std::isalpha((unsigned char)c) || c=='_'; }
+  bool is_ident(char c) { return std::isalnum((unsigned char)c) || c=='_'; }
+
+  bool tokenize(const std::string &expr, std::vector<Token> &tokens, std::string &err) {
+    for(const char *p = expr.c_str(); *p; ) {
+      // an operand is expected at the start, after an operator, '(' or ','
+      bool operand = (tokens.empty() ||
+		      tokens.back().type == Token::Type::Operator ||
+		      tokens.back().type == Token::Type::LeftParen ||
+		      tokens.back().type == Token::Type::Comma);
+
+      if (std::isspace((unsigned char)*p)) {
+	p++;
+
+      } else if (std::isdigit((unsigned char)*p) || (*p=='.' && std::isdigit((unsigned char)p[1]))) {
+	const char *b = p;
+	while(std::isdigit((unsigned char)*p) || *p=='.') p++;
+	if ((*p=='e' || *p=='E') &&
+	    (std::isdigit((unsigned char)p[1]) || ((p[1]=='-' || p[1]=='+') && std::isdigit((unsigned char)p[2])))) {
+	  p += 2;
+	  while(std::isdigit((unsigned char)*p)) p++;
+	}
+	std::string num(b, p);
+	if (num[0] == '.') {
+	  num.insert(0, "0"); // the interpreter wants a leading digit
+	}
+	tokens.push_back({ Token::Type::Number, num, -1, false, false });
+
+      } else if (is_ident_start(*p)) {
+	const char *b = p;
+	while(is_ident(*p)) p++;
+	std::string ident(b, p);
+	const char *q = p;
+	while(std::isspace((unsigned char)*q)) q++;
+	if (*q == '(') {
+	  for(auto &c : ident) c = (char)std::toupper((unsigned char)c);
+	  tokens.push_back({ Token::Type::Function, ident, -1, false, false });
+	} else {
+	  tokens.push_back({ Token::Type::Identifier, ident, -1, false, false });
+	}
+
+      } else if (*p == '(') {
+	tokens.push_back({ Token::Type::LeftParen, "(", -1, false, false });
+	p++;
+
+      } else if (*p == ')') {
+	tokens.push_back({ Token::Type::RightParen, ")", -1, false, false });
+	p++;
+
+      } else if (*p == ',') {
+	tokens.push_back({ Token::Type::Comma, ",", -1, false, false });
+	p++;
+
+      } else if (operand && (*p == '-' || *p == '+')) {
+	// unary minus becomes CHS, unary plus is a no-op
+	if (*p == '-') {
+	  tokens.push_back({ Token::Type::Operator, "CHS", s_unaryPrecedence, true, true });
+	}
+	p++;
+
+      } else {
+	const OpInfo *op = nullptr;
+	for(const auto &o : s_operators) {
+	  size_t len = strlen(o.sym);
+	  if (strncmp(p, o.sym, len) == 0) {
+	    op = &o;
+	    break;
+	  }
+	}
+	if (op == nullptr) {
+	  err = std::string("unexpected character '") + *p + "'";
+	  return false;
+	}
+	tokens.push_back({ Token::Type::Operator, op->word, op->precedence, op->rightAssociative, false });
+	p += strlen(op->sym);
+      }
     }
-
-    std::ostringstream ossStack;
-    for(const auto& t : stack) {
-        ossStack << " " << t;
-    }
-
-    printf(reportFmt
-           , token.str.c_str()
-           , ossQueue.str().c_str()
-           , ossStack.str().c_str()
-           , comment.c_str()
-    );
+    return true;
+  }
 }
 
-
-std::deque<Token> exprToTokens(const std::string& expr) {
-    std::deque<Token> tokens;
-
-    for(const auto* p = expr.c_str(); *p; ++p) {
-        if(isblank(*p)) {
-            // do nothing
-        } else if(isdigit(*p)) {
-            const auto* b = p;
-            while(isdigit(*p)||(*p=='.')) {
-                ++p;
-            }
-            const auto s = std::string(b, p);
-            tokens.push_back(Token { Token::Type::Number, s });
-            --p;
-        } else {
-            Token::Type t = Token::Type::Unknown;
-            int precedence = -1;
-            bool rightAssociative = false;
-            bool unary = false;
-            char c = *p;
-            switch(c) {
-            default:                                    break;
-            case '(':   t = Token::Type::LeftParen;     break;
-            case ')':   t = Token::Type::RightParen;    break;
-            case '^':   t = Token::Type::Operator;      precedence = 4; rightAssociative = true;  break;
-            case '*':   t = Token::Type::Operator;      precedence = 3; break;
-            case '/':   t = Token::Type::Operator;      precedence = 3; break;
-            case '+':   t = Token::Type::Operator;      precedence = 2; break;
-            case '-':
-                // If current token is '-'
-                // and if it is the first token, or preceded by another operator, or left-paren,
-                if(   tokens.empty()
-                   || tokens.back().type == Token::Type::Operator
-                   || tokens.back().type == Token::Type::LeftParen
-                ) {
-                    // it's unary '-'
-                    // note#1 : 'm' is a special operator name for unary '-'
-                    // note#2 : It has highest precedence than any of the infix operators
-                    unary = true;
-                    c = 'm';
-                    t = Token::Type::Operator;
-                    precedence = 5;
-                } else {
-                    // otherwise, it's binary '-'
-                    t = Token::Type::Operator;
-                    precedence = 2;
-                }
-                break;
-            }
-            const auto s = std::string(1, c);
-            tokens.push_back(Token { t, s, precedence, rightAssociative, unary });
-        }
+bool
+rpn::infix_to_rpn(const std::string &expr, std::vector<std::string> &words, std::string &assign, std::string &err) {
+  words.clear();
+  assign = "";
+  err = "";
+
+  // "name = expr" assigns the result, "==" is a comparison
+  std::string body = expr;
+  auto eq = body.find('=');
+  if (eq != std::string::npos && body.compare(eq, 2, "==") != 0 &&
+      (eq == 0 || std::string("<>!=").find(body[eq-1]) == std::string::npos)) {
+    std::vector<Token> lhs;
+    if (!tokenize(body.substr(0, eq), lhs, err)) {
+      return false;
     }
-
-    return tokens;
-}
-
-
-std::deque<Token> shuntingYard(const std::deque<Token>& tokens) {
-    std::deque<Token> queue;
-    std::vector<Token> stack;
-
-    // While there are tokens to be read:
-    for(auto token : tokens) {
-        // Read a token
-        switch(token.type) {
-        case Token::Type::Number:
-            // If the token is a number, then add it to the output queue
-            queue.push_back(token);
-            break;
-
-        case Token::Type::Operator:
-            {
-                // If the token is operator, o1, then:
-                const auto o1 = token;
-
-                // while there is an operator token,
-                while(!stack.empty()) {
-                    // o2, at the top of stack, and
-                    const auto o2 = stack.back();
-
-                    // either o1 is left-associative and its precedence is
-                    // *less than or equal* to that of o2,
-                    // or o1 if right associative, and has precedence
-                    // *less than* that of o2,
-                    if(
-                        (! o1.rightAssociative && o1.precedence <= o2.precedence)
-                    ||  (  o1.rightAssociative && o1.precedence <  o2.precedence)
-                    ) {
-                        // then pop o2 off the stack,
-                        stack.pop_back();
-                        // onto the output queue;
-                        queue.push_back(o2);
-
-                        continue;
-                    }
-
-                    // @@ otherwise, exit.
-                    break;
-                }
-
-                // push o1 onto the stack.
-                stack.push_back(o1);
-            }
-            break;
-
-        case Token::Type::LeftParen:
-            // If token is left parenthesis, then push it onto the stack
-            stack.push_back(token);
-            break;
-
-        case Token::Type::RightParen:
-            // If token is right parenthesis:
-            {
-                bool match = false;
-
-                // Until the token at the top of the stack
-                // is a left parenthesis,
-                while(! stack.empty() && stack.back().type != Token::Type::LeftParen) {
-                    // pop operators off the stack
-                    // onto the output queue.
-                    queue.push_back(stack.back());
-                    stack.pop_back();
-                    match = true;
-                }
-
-                if(!match && stack.empty()) {
-                    // If the stack runs out without finding a left parenthesis,
-                    // then there are mismatched parentheses.
-                    printf("RightParen error (%s)\n", token.str.c_str());
-                    return {};
-                }
-
-                // Pop the left parenthesis from the stack,
-                // but not onto the output queue.
-                stack.pop_back();
-            }
-            break;
-
-        default:
-            printf("error (%s)\n", token.str.c_str());
-            return {};
-        }
-
-        debugReport(token, queue, stack);
+    if (lhs.size() != 1 || lhs[0].type != Token::Type::Identifier) {
+      err = "assignment needs a single variable name";
+      return false;
     }
-
-    // When there are no more tokens to read:
-    //   While there are still operator tokens in the stack:
-    while(! stack.empty()) {
-        // If the operator token on the top of the stack is a parenthesis,
-        // then there are mismatched parentheses.
-        if(stack.back().type == Token::Type::LeftParen) {
-            printf("Mismatched parentheses error\n");
-            return {};
-        }
-
-        // Pop the operator onto the output queue.
-        queue.push_back(std::move(stack.back()));
-        stack.pop_back();
+    assign = lhs[0].str;
+    body = body.substr(eq+1);
+  }
+
+  std::vector<Token> tokens;
+  if (!tokenize(body, tokens, err)) {
+    return false;
+  }
+  if (tokens.empty()) {
+    err = "empty expression";
+    return false;
+  }
+
+  // operands and operators alternate, "2 x" or "a b + c" is a mistake
+  // rather than extra pushes
+  bool operand = false; // the last token ended an operand
+  for(size_t i=0; i<tokens.size(); i++) {
+    const auto &token = tokens[i];
+    switch(token.type) {
+    case Token::Type::Number:
+    case Token::Type::Identifier:
+    case Token::Type::Function:
+    case Token::Type::LeftParen:
+      if (operand) {
+	err = "missing operator before '" + token.str + "'";
+	return false;
+      }
+      operand = (token.type == Token::Type::Number || token.type == Token::Type::Identifier);
+      break;
+    case Token::Type::RightParen:
+      // f() has no arguments
+      if (!operand && !(i >= 2 && tokens[i-1].type == Token::Type::LeftParen && tokens[i-2].type == Token::Type::Function)) {
+	err = "missing operand before ')'";
+	return false;
+      }
+      operand = true;
+      break;
+    case Token::Type::Operator:
+    case Token::Type::Comma:
+      if (!operand && !token.unary) {
+	err = "missing operand before '" + token.str + "'";
+	return false;
+      }
+      operand = false;
+      break;
     }
-
-    debugReport(Token { Token::Type::Unknown, "End" }, queue, stack);
-
-    //Exit.
-    return queue;
-}
-
-
-int32_t compute(const std::string& expr) {
-    printf("Tokenize\n");
-    printf(reportFmt, "Token", "Queue", "Stack", "");
-    const auto tokens = exprToTokens(expr);
-    auto queue = shuntingYard(tokens);
-    std::vector<int> stack;
-
-    printf("\nCalculation\n");
-    printf(reportFmt, "Token", "Queue", "Stack", "");
-
-    while(! queue.empty()) {
-        std::string op;
-
-        const auto token = queue.front();
-        queue.pop_front();
-        switch(token.type) {
-        case Token::Type::Number:
-	  stack.push_back(std::strod(token.str, 0));
-            op = "Push " + token.str;
-            break;
-
-        case Token::Type::Operator:
-            {
-                if(token.unary) {
-                    // unray operators
-                    const auto rhs = stack.back();
-                    stack.pop_back();
-                    switch(token.str[0]) {
-                    default:
-                        printf("Operator error [%s]\n", token.str.c_str());
-                        exit(0);
-                        break;
-                    case 'm':                   // Special operator name for unary '-'
-                        stack.push_back(-rhs);
-                        break;
-                    }
-                    op = "Push (unary) " + token.str + " " + std::to_string(rhs);
-                } else {
-                    // binary operators
-                    const auto rhs = stack.back();
-                    stack.pop_back();
-                    const auto lhs = stack.back();
-                    stack.pop_back();
-
-                    switch(token.str[0]) {
-                    default:
-                        printf("Operator error [%s]\n", token.str.c_str());
-                        exit(0);
-                        break;
-                    case '^':
-                        stack.push_back(static_cast<int>(pow(lhs, rhs)));
-                        break;
-                    case '*':
-                        stack.push_back(lhs * rhs);
-                        break;
-                    case '/':
-                        stack.push_back(lhs / rhs);
-                        break;
-                    case '+':
-                        stack.push_back(lhs + rhs);
-                        break;
-                    case '-':
-                        stack.push_back(lhs - rhs);
-                        break;
-                    }
-                    op = "Push " + std::to_string(lhs) + " " + token.str + " " + std::to_string(rhs);
-                }
-            }
-            break;
-
-        default:
-            printf("Token error\n");
-            exit(0);
-        }
-        debugReport(token, queue, stack, op);
+  }
+  if (!operand) {
+    err = "missing operand at the end";
+    return false;
+  }
+
+  std::vector<Token> stack;
+  std::vector<size_t> args; // commas seen in each open function call
+  for(size_t i=0; i<tokens.size(); i++) {
+    const auto &token = tokens[i];
+    switch(token.type) {
+    case Token::Type::Number:
+    case Token::Type::Identifier:
+      words.push_back(token.str);
+      break;
+
+    case Token::Type::Function:
+      stack.push_back(token);
+      break;
+
+    case Token::Type::LeftParen:
+      if (!stack.empty() && stack.back().type == Token::Type::Function) {
+	args.push_back(0);
+      }
+      stack.push_back(token);
+      break;
+
+    case Token::Type::Operator:
+      // prefix operators have no left operand, so they can't pop anything
+      while(!token.unary && !stack.empty() && stack.back().type == Token::Type::Operator) {
+	const auto &o2 = stack.back();
+	if ((!token.rightAssociative && token.precedence <= o2.precedence) ||
+	    (token.rightAssociative && token.precedence < o2.precedence)) {
+	  words.push_back(o2.str);
+	  stack.pop_back();
+	} else {
+	  break;
+	}
+      }
+      stack.push_back(token);
+      break;
+
+    case Token::Type::Comma:
+    case Token::Type::RightParen:
+      while(!stack.empty() && stack.back().type == Token::Type::Operator) {
+	words.push_back(stack.back().str);
+	stack.pop_back();
+      }
+      if (stack.empty() || stack.back().type != Token::Type::LeftParen) {
+	err = (token.type == Token::Type::Comma) ? "',' outside of a function call" : "mismatched parentheses";
+	return false;
+      }
+      if (token.type == Token::Type::Comma) {
+	// only between the arguments of a call, "(x, y)" would leave an extra push
+	if (stack.size() < 2 || stack[stack.size()-2].type != Token::Type::Function) {
+	  err = "',' outside of a function call";
+	  return false;
+	}
+	args.back()++;
+      } else {
+	stack.pop_back();
+	if (!stack.empty() && stack.back().type == Token::Type::Function) {
+	  const auto &fn = stack.back();
+	  size_t n = (tokens[i-1].type == Token::Type::LeftParen) ? 0 : args.back()+1;
+	  args.pop_back();
+	  for(const auto &f : s_functions) {
+	    if (fn.str == f.word && n != f.args) {
+	      err = fn.str + " takes " + std::to_string(f.args) + " argument" + ((f.args == 1) ? "" : "s");
+	      return false;
+	    }
+	  }
+	  words.push_back(fn.str);
+	  stack.pop_back();
+	}
+      }
+      break;
     }
+  }
 
-    return stack.back();
-}
-
-
-int main() {
-    printf("Shunting-yard\n");
-
-    const std::vector<std::tuple<std::string, int32_t>> testCases = {
-        { "3+4*2/(1-5)^2^3" , 3     },  // Wikipedia's example
-        { "(2*3+3*4)"       , 18    },  // Report from @2kaud.
-        { "(3)+(4)"         , 7     },  // Report from @kayshav.
-        { "(-3)*(-2^3)"     , 24    },  // Unary '-'
-        { "cos(a)*(23.5)"     , 11    },  // trig
-    };
-
-    int errorCount = 0;
-    int testCount = 0;
-
-    for(const auto& testCase : testCases) {
-        testCount += 1;
-        const std::string& expr = std::get<0>(testCase);
-        const int32_t expected = std::get<1>(testCase);
-        printf("expr = %s\n\n", expr.c_str());
-
-        const int32_t result = compute(expr);
-
-        printf("\n  result = %d, expected = %d, ", result, expected);
-        if(result == expected) {
-            printf("OK\n\n\n");
-        } else {
-            printf("NG\n\n\n");
-            errorCount += 1;
-        }
+  while(!stack.empty()) {
+    if (stack.back().type != Token::Type::Operator) {
+      err = "mismatched parentheses";
+      return false;
     }
+    words.push_back(stack.back().str);
+    stack.pop_back();
+  }
 
-    if(errorCount != 0 || testCount != static_cast<int>(testCases.size())) {
-        printf("ERROR (errorCount=%d, testCount=%d)\n", errorCount, testCount);
-        exit(EXIT_FAILURE);
-    } else {
-        printf("OK\n");
-        exit(EXIT_SUCCESS);
-    }
+  return true;
 }
+
+/* end of qinc/rpn-lang/src/shunting-yard.cpp */
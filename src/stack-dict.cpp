@@ -52,6 +52,17 @@ STACK_OPn_FUNC(rollun);
 STACK_OPn_FUNC(tuckn);
 STACK_OPn_FUNC(reversen);
 
+// nothing to undo/redo isn't an error, the stack just stays as it is
+static rpn::WordDefinition::Result STACK_OP(undo)(rpn::Interp &rpn, rpn::WordContext *ctx, std::string &rest) {
+  rpn.stack.undo();
+  return rpn::WordDefinition::Result::ok;
+}
+
+static rpn::WordDefinition::Result STACK_OP(redo)(rpn::Interp &rpn, rpn::WordContext *ctx, std::string &rest) {
+  rpn.stack.redo();
+  return rpn::WordDefinition::Result::ok;
+}
+
 // depth is special because we push the value back on the stack
 static rpn::WordDefinition::Result STACK_OP(depth)(rpn::Interp &rpn, rpn::WordContext *ctx, std::string &rest) {
   rpn.stack.push_integer(rpn.stack.depth());
@@ -68,6 +79,8 @@ rpn::Interp::addStackWords() {
   ADD_STACK_OP(rpn, "DROP", one, drop);
   ADD_STACK_OP(rpn, "CLEAR", zero, clear);
   ADD_STACK_OP(rpn, "DEPTH", zero, depth);
+  ADD_STACK_OP(rpn, "UNDO", zero, undo);
+  ADD_STACK_OP(rpn, "REDO", zero, redo);
   ADD_STACK_OP(rpn, "SWAP", two, swap);
   ADD_STACK_OP(rpn, "ROLLU", zero, rollu);
   ADD_STACK_OP(rpn, "ROLLD", zero, rolld);
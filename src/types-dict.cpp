@@ -42,6 +42,15 @@ NATIVE_WORD_DECL(types, to_string) {
   return rv;
 }
 
+NATIVE_WORD_DECL(t_string, concat) {
+  rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
+  auto b = rpn.stack.pop();
+  auto a = rpn.stack.pop();
+  POP_CAST(StString,a).inner().append(POP_CAST(StString,b).inner());
+  rpn.stack.push(std::move(a));
+  return rv;
+}
+
 /***************************************************
  * Object
  */
@@ -64,9 +73,10 @@ NATIVE_WORD_DECL(t_object, add_string_any_object) {
   rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
   std::string ident = rpn.stack.pop_string();
   auto val = rpn.stack.pop();
-  auto &sob = rpn.stack.peek(1);
-  StObject &obj = PEEK_CAST(StObject,sob);
+  auto sob = rpn.stack.pop();
+  StObject &obj = POP_CAST(StObject,sob);
   obj.inner().add_value(ident,*val.get());
+  rpn.stack.push(std::move(sob));
   return rv;
 }
 
@@ -79,12 +89,27 @@ NATIVE_WORD_DECL(t_object, add_object_string_any) {
  * Array
  */
 NATIVE_WORD_DECL(t_array, to_array) {
-  rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::implementation_error;
+  // ( x1 .. xn n -- array ), x1 is element 0
+  rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
+  int n = (int)rpn.stack.pop_integer();
+  StArray arr;
+  for(int i=n; i>0; i--) {
+    arr.inner().add_value(rpn.stack.peek(i));
+  }
+  rpn.stack.dropn(n);
+  rpn.stack.push(arr);
   return rv;
 }
 
 NATIVE_WORD_DECL(t_array, array_to) {
-  rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::implementation_error;
+  // ( array -- x1 .. xn n )
+  rpn::WordDefinition::Result rv = rpn::WordDefinition::Result::ok;
+  auto sob = rpn.stack.pop();
+  StArray &arr = POP_CAST(StArray,sob);
+  for(auto const &e : arr.inner().val()) {
+    rpn.stack.push(*e);
+  }
+  rpn.stack.push_integer((int64_t)arr.inner().val().size());
   return rv;
 }
 
@@ -284,6 +309,8 @@ rpn::Interp::addTypeWords() {
   addDefinition("->FLOAT", NATIVE_WORD_WDEF(types, rpn::StackSizeValidator::one, to_float, nullptr));
   addDefinition("->STRING", NATIVE_WORD_WDEF(types, rpn::StackSizeValidator::one, to_string, nullptr));
 
+  addDefinition("CONCAT", NATIVE_WORD_WDEF(t_string, rpn::StrictTypeValidator::d2_string_string, concat, nullptr));
+
   addDefinition("->OBJECT", NATIVE_WORD_WDEF(t_object, rpn::StrictTypeValidator::d2_string_any, to_object, nullptr));
   addDefinition("OBJECT->", NATIVE_WORD_WDEF(t_object, rpn::StrictTypeValidator::d1_object, object_to, nullptr));
   addDefinition("OBJ->", NATIVE_WORD_WDEF(t_object, rpn::StrictTypeValidator::d1_object, object_to, nullptr));
@@ -295,6 +322,8 @@ rpn::Interp::addTypeWords() {
   addDefinition("+", NATIVE_WORD_WDEF(t_object, rpn::StrictTypeValidator::d3_string_any_object, add_string_any_object, nullptr));
   addDefinition("+", NATIVE_WORD_WDEF(t_array, rpn::StrictTypeValidator::d2_array_any, add_array_any, nullptr));
   addDefinition("+", NATIVE_WORD_WDEF(t_array, rpn::StrictTypeValidator::d2_any_array, add_any_array, nullptr));
+  // after the object member adds, ( obj val key ) has two strings on top too
+  addDefinition("+", NATIVE_WORD_WDEF(t_string, rpn::StrictTypeValidator::d2_string_string, concat, nullptr));
 
   addDefinition("+", NATIVE_WORD_WDEF(vec3, rpn::StrictTypeValidator::d2_vec3_vec3, add_vec3, nullptr));
   addDefinition("+", NATIVE_WORD_WDEF(vec3, rpn::StrictTypeValidator::d2_vec3_double, add_vec3_num, nullptr));
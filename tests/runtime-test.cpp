@@ -17,7 +17,12 @@
 
 #include "rpn.h"
 
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <thread>
 
 rpn::Interp g_rpn;
 
@@ -841,6 +846,909 @@ NEXT
   }
 }
 
+TEST_CASE( "eval", "runtime" ) {
+  std::string line;
+  rpn::WordDefinition::Result st;
+  g_rpn.stack.clear();
+
+  line = (".\" p1x = 1\" EVAL .\" p1y = 2\" EVAL .\" p2x = 3\" EVAL .\" p2y = 6\" EVAL");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (0 == g_rpn.stack.depth()) );
+
+  line = (".\" ma = (p2y - p1y) / (p2x - p1x)\" EVAL ma");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (2 == g_rpn.stack.pop_integer()) );
+
+  line = (".\" -2^2 + 3*hypot(3.0, 4.0)\" EVAL");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (11 == g_rpn.stack.pop_double()) );
+
+  line = (": slope .\" (p2y - p1y) / (p2x - p1x)\" EVAL ; 7.0 .\" p2y\" STO slope .\" p2y\" RCL");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (7 == g_rpn.stack.pop_double()) );
+  REQUIRE( (2.5 == g_rpn.stack.pop_double()) );
+
+  line = (".\" (1 + 2\" EVAL");
+  st = g_rpn.parse(line);
+  REQUIRE( (st != rpn::WordDefinition::Result::ok) );
+
+  // operands and operators have to alternate
+  for(const char *bad : { "2 x", "a b + c", "(1) 2", "1 * / 2", "1 +", "f(1,)" }) {
+    std::vector<std::string> words;
+    std::string assign, err;
+    REQUIRE( !rpn::infix_to_rpn(bad, words, assign, err) );
+  }
+  std::vector<std::string> words;
+  std::string assign, err;
+  REQUIRE( (rpn::infix_to_rpn("-x * -(2 + y)", words, assign, err) && 7 == words.size()) );
+
+  // ',' only separates the arguments of a call, and the math words count them
+  for(const char *bad : { "a = (x, y) * 2", "(1, 2)", "sin(1, 2)", "hypot(1)", "hypot((1, 2))", "rand(1)" }) {
+    REQUIRE( !rpn::infix_to_rpn(bad, words, assign, err) );
+  }
+  REQUIRE( (rpn::infix_to_rpn("atan2(y, hypot(x, 1)) + f(1, 2, 3) + rand()", words, assign, err) && 12 == words.size()) );
+
+  // the programs are cached, up to a point
+  auto before = g_rpn.memoryStats();
+  bool ok = true;
+  for(int i=0; i<1000; i++) {
+    ok = ok && g_rpn.sync_eval(".\" " + std::to_string(i) + " + 1\" EVAL DROP") == rpn::WordDefinition::Result::ok;
+  }
+  REQUIRE( ok );
+  REQUIRE( (g_rpn.memoryStats().progns < before.progns + 300) );
+  g_rpn.stack.clear();
+}
+
+TEST_CASE( "native", "runtime" ) {
+  std::string line;
+  rpn::WordDefinition::Result st;
+  g_rpn.stack.clear();
+
+  line = ("1 1 == NATIVE");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+
+  line = (": n-hyp ( a b -- c ) SQ SWAP SQ + SQRT ;");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  line = (": n-mix ( a b -- a/pi+2b 6 ) 2 * SWAP k_PI / + 2 3 * ;");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  line = (": n-trig ( a -- a b ) DUP COS 2 PICK SIN HYPOT ;");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+
+  line = ("3.0 4.0 n-hyp");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (5.0 == g_rpn.stack.pop_double()) );
+
+  // integer inputs are interpreted
+  line = ("3 4 n-hyp");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (5.0 == g_rpn.stack.pop_double()) );
+
+  line = ("6.2831853071795862 1.5 n-mix");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (6 == g_rpn.stack.pop_integer()) );
+  REQUIRE_THAT(g_rpn.stack.pop_double(), Catch::Matchers::WithinAbs(5.0, 0.000001));
+
+  line = ("30.0 n-trig");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE_THAT(g_rpn.stack.pop_double(), Catch::Matchers::WithinAbs(1.0, 0.000001));
+  REQUIRE( (30.0 == g_rpn.stack.pop_double()) );
+
+  line = ("1 0 == NATIVE");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+}
+
+TEST_CASE( "bound call sites", "runtime" ) {
+  std::string line;
+  rpn::WordDefinition::Result st;
+  g_rpn.stack.clear();
+
+  line = (": t-mix ( a b -- a+b a*b ) OVER OVER + ROTD * ;");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+
+  // each shape of input binds its own overloads
+  for(int pass=0; pass<2; pass++) {
+    line = ("2 3 t-mix");
+    st = g_rpn.parse(line);
+    REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+    REQUIRE( (6 == g_rpn.stack.pop_integer()) );
+    REQUIRE( (5 == g_rpn.stack.pop_integer()) );
+
+    line = ("2.5 2 t-mix");
+    st = g_rpn.parse(line);
+    REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+    REQUIRE( (5.0 == g_rpn.stack.pop_double()) );
+    REQUIRE( (4.5 == g_rpn.stack.pop_double()) );
+  }
+
+  // and what doesn't fit is still caught
+  line = ("1 1 == 2 t-mix");
+  st = g_rpn.parse(line);
+  REQUIRE( (st != rpn::WordDefinition::Result::ok) );
+  g_rpn.stack.clear();
+
+  line = (": t-sum ( n -- sum ) 0 SWAP 0 SWAP FOR i i + NEXT ;");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  line = ("5 t-sum 5 t-sum");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (10.0 == g_rpn.stack.pop_double()) );
+  REQUIRE( (10.0 == g_rpn.stack.pop_double()) );
+}
+
+TEST_CASE( "if and case", "runtime" ) {
+  std::string line;
+  rpn::WordDefinition::Result st;
+  g_rpn.stack.clear();
+
+  line = (": t-sign ( x -- s ) DUP 0 < IF DROP 0 1 - ELSE 0 > IF 1 ELSE 0 THEN THEN ;");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  line = ("-5 t-sign 7 t-sign 0 t-sign");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (0 == g_rpn.stack.pop_integer()) );
+  REQUIRE( (1 == g_rpn.stack.pop_integer()) );
+  REQUIRE( (-1 == g_rpn.stack.pop_integer()) );
+
+  line = (": t-case ( n -- s ) CASE 1 OF .\" one\" ENDOF 2 OF .\" two\" ENDOF .\" many\" SWAP ENDCASE ;");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  line = ("1 t-case 2 t-case 5 t-case");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (g_rpn.stack.depth() == 3) );
+  REQUIRE( ("many" == g_rpn.stack.pop_string()) );
+  REQUIRE( ("two" == g_rpn.stack.pop_string()) );
+  REQUIRE( ("one" == g_rpn.stack.pop_string()) );
+
+  // a selector of another type than the OF values takes the default
+  line = (".\" 1\" t-case 1.0 2.0 3.0 ->VEC3 t-case");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (g_rpn.stack.depth() == 2) );
+  REQUIRE( ("many" == g_rpn.stack.pop_string()) );
+  REQUIRE( ("many" == g_rpn.stack.pop_string()) );
+
+  // typed at top level, the construct runs when it closes
+  line = ("1 2 < IF 10 ELSE 20 THEN");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (10 == g_rpn.stack.pop_integer()) );
+
+  line = (": t-open IF 1 ;");
+  st = g_rpn.parse(line);
+  REQUIRE( (st != rpn::WordDefinition::Result::ok) );
+  g_rpn.stack.clear();
+}
+
+TEST_CASE( "indefinite loops", "runtime" ) {
+  std::string line;
+  rpn::WordDefinition::Result st;
+  g_rpn.stack.clear();
+
+  line = (": t-tri ( n -- sum ) 0 SWAP BEGIN DUP 0 > WHILE SWAP OVER + SWAP 1 - REPEAT DROP ;");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  line = ("4 t-tri 0 t-tri 1000 t-tri");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (500500 == g_rpn.stack.pop_integer()) );
+  REQUIRE( (0 == g_rpn.stack.pop_integer()) );
+  REQUIRE( (10 == g_rpn.stack.pop_integer()) );
+
+  line = ("1 DO 2 * DUP 100 > UNTIL");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (128 == g_rpn.stack.pop_integer()) );
+
+  line = (": t-open BEGIN 1 UNTIL REPEAT ;");
+  st = g_rpn.parse(line);
+  REQUIRE( (st != rpn::WordDefinition::Result::ok) );
+  g_rpn.stack.clear();
+}
+
+TEST_CASE( "compiled calls", "runtime" ) {
+  std::string line;
+  rpn::WordDefinition::Result st;
+  g_rpn.stack.clear();
+
+  line = (": t-fact ( n -- n! ) DUP 1 > IF DUP 1 - t-fact * THEN ;");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  line = ("10 t-fact");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (3628800 == g_rpn.stack.pop_integer()) );
+
+  // deeper than the C++ stack would allow, tail calls don't even grow the return stack
+  line = (": t-down ( n -- 0 ) DUP 0 > IF 1 - t-down THEN ;");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  line = (": t-up ( n -- n ) DUP 0 > IF 1 - t-up 1 + THEN ;");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  line = ("200000 t-down 200000 t-up");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (200000 == g_rpn.stack.pop_integer()) );
+  REQUIRE( (0 == g_rpn.stack.pop_integer()) );
+
+  // an error deep in the calls unwinds all of them
+  line = ("5 t-up .\" x\" t-down");
+  st = g_rpn.parse(line);
+  REQUIRE( (st != rpn::WordDefinition::Result::ok) );
+  g_rpn.stack.clear();
+  line = ("3 t-up");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (3 == g_rpn.stack.pop_integer()) );
+}
+
+TEST_CASE( "inlined calls", "runtime" ) {
+  std::string line;
+  rpn::WordDefinition::Result st;
+  g_rpn.stack.clear();
+
+  line = (": t-feed 150 ; : t-half 2 / ; : t-use ( -- n ) t-feed t-half t-feed + ;");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  line = ("t-use");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (225 == g_rpn.stack.pop_integer()) );
+
+  // redefining a word that was spliced in is seen by its callers
+  line = (": t-feed 100 ; t-use");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (150 == g_rpn.stack.pop_integer()) );
+
+  // bodies with jumps keep their targets when spliced
+  line = (": t-abs DUP 0 < IF CHS THEN ; : t-dist - t-abs ; 3 8 t-dist 8 3 t-dist");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (5 == g_rpn.stack.pop_integer()) );
+  REQUIRE( (5 == g_rpn.stack.pop_integer()) );
+}
+
+TEST_CASE( "loop invariants", "runtime" ) {
+  std::string line;
+  rpn::WordDefinition::Result st;
+  g_rpn.stack.clear();
+
+  // 3 PICK 1 + is hoisted, the whole sum term is computed from i
+  line = (": t-lin ( n -- n sum ) 0 0 5 FOR i i 3 * 2 + 3 PICK 1 + i * + + NEXT ; 4 t-lin");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE_THAT( g_rpn.stack.pop_as_double(), Catch::Matchers::WithinAbs(90., 0.0001) );
+  REQUIRE( (4 == g_rpn.stack.pop_integer()) );
+
+  // literal bounds, unrolled into the caller
+  line = (": t-unr 0 0 4 FOR i i + NEXT ; t-unr");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE_THAT( g_rpn.stack.pop_as_double(), Catch::Matchers::WithinAbs(6., 0.0001) );
+
+  // a fractional start keeps the multiply, the same as the loop as written
+  line = (": t-frac 0.1 1000.1 FOR i i 3 * NEXT ; t-frac");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (1000 == g_rpn.stack.depth()) );
+  bool same = true;
+  double i = 0.1;
+  for(int n=1000; n>0; n--, i += 1) {
+    same = same && (i * 3 == g_rpn.stack.peek_double(n));
+  }
+  REQUIRE( same );
+  g_rpn.stack.clear();
+}
+
+static double t_lerp(double a, double b, double t) {
+  return a + (b-a)*t;
+}
+static std::string t_repeat(const std::string &s, int64_t n) {
+  std::string rv;
+  while(n-- > 0) rv += s;
+  return rv;
+}
+
+TEST_CASE( "bound words", "runtime" ) {
+  std::string line;
+  rpn::WordDefinition::Result st;
+  g_rpn.stack.clear();
+
+  rpn::bind::add_number<t_lerp, t_lerp>(g_rpn, "T-LERP");
+  rpn::bind::add<t_repeat>(g_rpn, "T-REPEAT");
+
+  line = ("2.0 4 0.25 T-LERP 2 4 1 T-LERP");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE_THAT( g_rpn.stack.pop_double(), Catch::Matchers::WithinAbs(4., 0.0001) );
+  REQUIRE_THAT( g_rpn.stack.pop_double(), Catch::Matchers::WithinAbs(2.5, 0.0001) );
+
+  line = (".\" ab\" 3 T-REPEAT");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( ("ababab" == g_rpn.stack.pop_string()) );
+
+  // the result is written in place, over an item that was smaller
+  line = (".\" abcdefghij\" 1000 T-REPEAT");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (g_rpn.stack.bytes() == g_rpn.stack.peek(1).footprint()) );
+  REQUIRE( (g_rpn.stack.bytes() > 10000) );
+  g_rpn.stack.drop();
+  REQUIRE( (0 == g_rpn.stack.bytes()) );
+
+  // the validator comes from the signature
+  line = (".\" ab\" 3.0 T-REPEAT");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::param_error) );
+  g_rpn.stack.clear();
+}
+
+class StTag : public rpn::Stack::Object {
+public:
+  StTag(const std::string &name) : _name(name) {}
+  virtual bool operator==(const Object &orhs) const override {
+    auto *rhs = dynamic_cast<const StTag*>(&orhs);
+    return (rhs != nullptr && _name == rhs->_name);
+  }
+  virtual operator std::string() const override { return "#" + _name; }
+  virtual std::unique_ptr<Object> deep_copy() const override { return std::make_unique<StTag>(*this); }
+  std::string _name;
+};
+static StTag t_tag(const std::string &name) {
+  return StTag(name);
+}
+static std::string t_untag(const StTag &tag) {
+  return tag._name;
+}
+
+TEST_CASE( "host types", "types" ) {
+  std::string line;
+  rpn::WordDefinition::Result st;
+  g_rpn.stack.clear();
+
+  rpn::TypeId id = rpn::Types::add<StTag>("tag");
+  REQUIRE( (id > rpn::Types::t_vec3) );
+  REQUIRE( (id == rpn::Types::of<StTag>()) );
+  REQUIRE( ("tag" == rpn::Types::name(id)) );
+  rpn::bind::add<t_tag>(g_rpn, "->TAG");
+  rpn::bind::add<t_untag>(g_rpn, "TAG->");
+
+  line = (".\" abc\" ->TAG");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (id == g_rpn.stack.type(1)) );
+
+  line = ("TAG->");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( ("abc" == g_rpn.stack.pop_string()) );
+
+  line = ("3 TAG->");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::param_error) );
+  g_rpn.stack.clear();
+}
+
+TEST_CASE( "undo history", "stack" ) {
+  rpn::WordDefinition::Result st;
+  g_rpn.stack.clear();
+
+  // one undo level per eval
+  g_rpn.sync_eval("1 2");
+  g_rpn.sync_eval("+");
+  REQUIRE( (1 == g_rpn.stack.depth() && 3 == g_rpn.stack.peek_integer(1)) );
+
+  st = g_rpn.sync_eval("UNDO");
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (2 == g_rpn.stack.depth() &&
+	    2 == g_rpn.stack.peek_integer(1) &&
+	    1 == g_rpn.stack.peek_integer(2)) );
+  REQUIRE( (1 == g_rpn.stack.redo_levels()) );
+
+  g_rpn.sync_eval("REDO");
+  REQUIRE( (1 == g_rpn.stack.depth() && 3 == g_rpn.stack.peek_integer(1)) );
+
+  // a change after undo drops the redo levels
+  g_rpn.sync_eval("UNDO");
+  g_rpn.sync_eval("5");
+  REQUIRE( (0 == g_rpn.stack.redo_levels()) );
+  REQUIRE( (false == g_rpn.stack.redo()) );
+  REQUIRE( (3 == g_rpn.stack.depth() && 5 == g_rpn.stack.peek_integer(1)) );
+
+  // REVERSE moves every slot, one undo puts them back
+  g_rpn.stack.clear();
+  g_rpn.sync_eval("1 2 3");
+  size_t levels = g_rpn.stack.undo_levels();
+  g_rpn.sync_eval("REVERSE");
+  REQUIRE( (levels+1 == g_rpn.stack.undo_levels() && 1 == g_rpn.stack.peek_integer(1)) );
+  g_rpn.sync_eval("UNDO");
+  REQUIRE( (3 == g_rpn.stack.depth() &&
+	    3 == g_rpn.stack.peek_integer(1) &&
+	    1 == g_rpn.stack.peek_integer(3)) );
+
+  // deep stack, many small commands
+  g_rpn.stack.clear();
+  g_rpn.sync_eval("0 1000 FOR i i NEXT");
+  for(int i=0; i<50; i++) {
+    g_rpn.sync_eval("DUP +");
+  }
+  REQUIRE( (1000 == g_rpn.stack.depth() && ldexp(999.0, 50) == g_rpn.stack.peek_double(1)) );
+  for(int i=0; i<50; i++) {
+    REQUIRE( (true == g_rpn.stack.undo()) );
+  }
+  REQUIRE( (1000 == g_rpn.stack.depth() &&
+	    999 == g_rpn.stack.peek_double(1) &&
+	    0 == g_rpn.stack.peek_double(1000)) );
+  g_rpn.stack.redo();
+  REQUIRE( (1998 == g_rpn.stack.peek_double(1)) );
+  g_rpn.stack.clear();
+}
+
+TEST_CASE( "map reduce", "words" ) {
+  std::string line;
+  rpn::WordDefinition::Result st;
+  g_rpn.stack.clear();
+
+  line = (": t-sq DUP * ; : t-add + ; : t-sub - ;");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+
+  // small, one element at a time
+  line = ("1 2 3 3 ->ARRAY .\" t-sq\" MAP ARRAY->");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( ((3 == g_rpn.stack.pop_integer()) &&
+	    (9 == g_rpn.stack.peek_integer(1)) &&
+	    (4 == g_rpn.stack.peek_integer(2)) &&
+	    (1 == g_rpn.stack.peek_integer(3))) );
+  g_rpn.stack.clear();
+
+  line = ("1 2 3 3 ->ARRAY 10 .\" t-add\" REDUCE");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (16 == g_rpn.stack.pop_integer()) );
+
+  // large arrays of doubles are split across threads when the word compiles natively
+  line = ("0 10000 FOR i i NEXT 10000 ->ARRAY .\" t-sq\" MAP");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (1 == g_rpn.stack.depth()) );
+  auto &sq = dynamic_cast<StArray&>(g_rpn.stack.peek(1)).inner().val();
+  REQUIRE( (10000 == sq.size()) );
+  REQUIRE( (9999.0*9999.0 == dynamic_cast<StDouble&>(*sq[9999]).val()) );
+  REQUIRE( (1234.0*1234.0 == dynamic_cast<StDouble&>(*sq[1234]).val()) );
+  REQUIRE( (g_rpn.parallelStats().map >= 1) );
+
+  // REDUCE folds in order, whatever the word; PARREDUCE splits it when asked
+  auto before = g_rpn.parallelStats();
+  line = ("DUP 0.0 .\" t-sub\" REDUCE");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (-333283335000.0 == g_rpn.stack.pop_double()) );
+  REQUIRE( (before.reduce == g_rpn.parallelStats().reduce) );
+
+  line = ("0.0 .\" t-add\" PARREDUCE");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (333283335000.0 == g_rpn.stack.pop_double()) );
+  REQUIRE( (before.reduce + 1 == g_rpn.parallelStats().reduce) );
+
+  line = ("1 2 2 ->ARRAY .\" t-add\" MAP");
+  st = g_rpn.parse(line);
+  REQUIRE( (st != rpn::WordDefinition::Result::ok) );
+  g_rpn.stack.clear();
+}
+
+TEST_CASE( "parfor", "control" ) {
+  std::string line;
+  rpn::WordDefinition::Result st;
+  g_rpn.stack.clear();
+
+  // results go under the input, so the iterations are independent
+  line = (": t-par 0 10000 PARFOR i i i * OVER * SWAP NEXT ; "
+	  ": t-seq 0 10000 FOR i i i * OVER * SWAP NEXT ;");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+
+  auto before = g_rpn.parallelStats();
+  line = ("2.0 t-par");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (before.parfor + 1 == g_rpn.parallelStats().parfor) );
+  REQUIRE( (10001 == g_rpn.stack.depth()) );
+  REQUIRE( (2.0 == g_rpn.stack.peek_double(1)) );
+  REQUIRE( (2.0*9999*9999 == g_rpn.stack.peek_double(2)) );
+  REQUIRE( (2.0*1234*1234 == g_rpn.stack.peek_double(10001-1234)) );
+  REQUIRE( (0.0 == g_rpn.stack.peek_double(10001)) );
+
+  line = ("2.0 t-seq");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (20002 == g_rpn.stack.depth()) );
+  bool same = true;
+  for(int i=1; i<=10001; i++) {
+    same &= (g_rpn.stack.peek(i) == g_rpn.stack.peek(i+10001));
+  }
+  REQUIRE( same );
+  g_rpn.stack.clear();
+
+  // so does one that would go over the request's budget, and stops in it
+  g_rpn.budget({ 5000, std::chrono::milliseconds(0) });
+  auto r = g_rpn.submit("2.0 t-par").get();
+  g_rpn.budget({});
+  REQUIRE( (r.result == rpn::WordDefinition::Result::cancelled) );
+  REQUIRE( (before.parfor + 1 == g_rpn.parallelStats().parfor) );
+  g_rpn.stack.clear();
+
+  // a body that isn't independent runs as a FOR loop
+  line = ("1 0 5 PARFOR i i + NEXT");
+  st = g_rpn.parse(line);
+  REQUIRE( (st == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (11 == g_rpn.stack.pop_as_double()) );
+  g_rpn.stack.clear();
+}
+
+TEST_CASE( "submit", "interp" ) {
+  g_rpn.stack.clear();
+
+  auto r1 = g_rpn.submit("1 2 +", 1).get();
+  REQUIRE( (r1.result == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (1 == r1.outputs.size() && "3" == r1.outputs[0]->to_string()) );
+
+  // back to back, harvested afterwards, in order
+  std::vector<std::string> lines(1000, "1 +");
+  lines.push_back("no-such-word");
+  auto futures = g_rpn.submit(lines, 2);
+  std::vector<rpn::Interp::Reply> replies;
+  for(auto &f : futures) {
+    replies.push_back(f.get());
+  }
+  REQUIRE( (1001 == replies.size()) );
+  REQUIRE( (replies[0].result == rpn::WordDefinition::Result::ok) );
+  REQUIRE( ("4" == replies[0].outputs[0]->to_string()) );
+  REQUIRE( ("1003" == replies[999].outputs[0]->to_string()) );
+  REQUIRE( (1 == replies[999].outputs.size()) ); // only one item to capture
+  REQUIRE( (replies[1000].result != rpn::WordDefinition::Result::ok) );
+  g_rpn.stack.clear();
+}
+
+TEST_CASE( "budget", "interp" ) {
+  g_rpn.stack.clear();
+
+  // a runaway loop stops at its budget, the next request runs as usual
+  g_rpn.budget({ 100000, std::chrono::milliseconds(0) });
+  auto f1 = g_rpn.submit("DO 1 2 == UNTIL");
+  g_rpn.budget({});
+  auto f2 = g_rpn.submit("CLEAR 42", 1);
+  REQUIRE( (f1.get().result == rpn::WordDefinition::Result::cancelled) );
+  auto r2 = f2.get();
+  REQUIRE( (r2.result == rpn::WordDefinition::Result::ok && "42" == r2.outputs[0]->to_string()) );
+
+  g_rpn.budget({ 0, std::chrono::milliseconds(20) });
+  REQUIRE( (g_rpn.submit("DO 1 2 == UNTIL").get().result == rpn::WordDefinition::Result::cancelled) );
+  g_rpn.budget({});
+
+  auto f3 = g_rpn.submit("DO 1 2 == UNTIL");
+  while (f3.wait_for(std::chrono::milliseconds(5)) != std::future_status::ready) {
+    g_rpn.cancel();
+  }
+  REQUIRE( (f3.get().result == rpn::WordDefinition::Result::cancelled) );
+  g_rpn.stack.clear();
+}
+
+TEST_CASE( "quantum", "interp" ) {
+  // a long file lets a request queued behind it run, and ends as it would have
+  auto path = std::filesystem::temp_directory_path() / "rpn-quantum-test.rpn";
+  {
+    std::ofstream ofs(path);
+    ofs << "CLEAR 0" << std::endl;
+    for(int i=0; i<500; i++) {
+      ofs << "0 1000 FOR i i DROP NEXT 1 +" << std::endl;
+    }
+  }
+  g_rpn.quantum(std::chrono::milliseconds(1));
+  std::atomic<bool> fileDone(false);
+  std::promise<rpn::WordDefinition::Result> file;
+  std::promise<bool> before;
+  g_rpn.parseFile(path.string(), [&](rpn::WordDefinition::Result rv) {
+      fileDone = true;
+      file.set_value(rv);
+    });
+  g_rpn.eval("1 DROP", [&](rpn::WordDefinition::Result) {
+      before.set_value(!fileDone);
+    });
+  REQUIRE( before.get_future().get() );
+  REQUIRE( (file.get_future().get() == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (1 == g_rpn.stack.depth() && 500 == g_rpn.stack.peek_integer(1)) );
+  g_rpn.quantum(std::chrono::milliseconds(50));
+  std::filesystem::remove(path);
+  g_rpn.stack.clear();
+}
+
+TEST_CASE( "lanes", "interp" ) {
+  // a keypress doesn't wait for a bulk file, even one that never yields its quantum
+  auto path = std::filesystem::temp_directory_path() / "rpn-lanes-test.rpn";
+  {
+    std::ofstream ofs(path);
+    ofs << "CLEAR 0" << std::endl;
+    for(int i=0; i<500; i++) {
+      ofs << "0 1000 FOR i i DROP NEXT 1 +" << std::endl;
+    }
+  }
+  g_rpn.quantum(std::chrono::milliseconds(0));
+  auto before = g_rpn.laneStats(rpn::Interp::Priority::interactive);
+  std::atomic<bool> fileDone(false);
+  std::promise<rpn::WordDefinition::Result> file;
+  g_rpn.parseFile(path.string(), [&](rpn::WordDefinition::Result rv) {
+      fileDone = true;
+      file.set_value(rv);
+    });
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  auto key = g_rpn.submit("1 DROP");
+  REQUIRE( (key.get().result == rpn::WordDefinition::Result::ok && !fileDone) );
+  REQUIRE( (file.get_future().get() == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (500 == g_rpn.stack.peek_integer(1)) );
+
+  auto after = g_rpn.laneStats(rpn::Interp::Priority::interactive);
+  auto bulk = g_rpn.laneStats(rpn::Interp::Priority::bulk);
+  REQUIRE( (after.requests == before.requests + 1) );
+  REQUIRE( (bulk.requests >= 1 && bulk.latency_max >= bulk.wait_max) );
+
+  // and it still gets somewhere while keypresses keep coming
+  {
+    std::ofstream ofs(path);
+    for(int i=0; i<100; i++) {
+      ofs << "1 DROP" << std::endl;
+    }
+  }
+  std::atomic<int> keys(0);
+  std::atomic<bool> stop(false);
+  std::function<void(rpn::WordDefinition::Result)> again = [&](rpn::WordDefinition::Result) {
+    if (!stop && ++keys < 20000) {
+      g_rpn.eval("1 DROP", again);
+    }
+  };
+  for(int i=0; i<4; i++) {
+    g_rpn.eval("1 DROP", again);
+  }
+  std::promise<rpn::WordDefinition::Result> file2;
+  g_rpn.parseFile(path.string(), [&](rpn::WordDefinition::Result rv) {
+      stop = true;
+      file2.set_value(rv);
+    });
+  REQUIRE( (file2.get_future().get() == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (keys < 20000) );
+  g_rpn.submit("").get(); // the keypresses queued before it stopped
+  g_rpn.quantum(std::chrono::milliseconds(50));
+  std::filesystem::remove(path);
+  g_rpn.stack.clear();
+}
+
+TEST_CASE( "reload", "interp" ) {
+  auto path = std::filesystem::temp_directory_path() / "rpn-reload-test.rpn";
+  auto load = [&path](const char *text, bool reload) {
+    {
+      std::ofstream ofs(path);
+      ofs << text;
+    }
+    std::promise<rpn::WordDefinition::Result> done;
+    auto handler = [&done](rpn::WordDefinition::Result rv) { done.set_value(rv); };
+    if (reload) {
+      g_rpn.reloadFile(path.string(), handler);
+    } else {
+      g_rpn.parseFile(path.string(), handler);
+    }
+    return done.get_future().get();
+  };
+  g_rpn.stack.clear();
+
+  REQUIRE( (load(": t-sq DUP * ;\n: t-quad t-sq t-sq ;\n: t-gone 1 ;\n7\n", false) == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (1 == g_rpn.stack.depth()) );
+  auto r = g_rpn.submit("DROP 3 t-quad", 1).get();
+  REQUIRE( ("81" == r.outputs[0]->to_string()) );
+
+  // t-quad isn't compiled again, but it calls the new t-sq; the 7 isn't pushed again
+  REQUIRE( (load(": t-sq ( n -- n^3 )\n  DUP DUP * * ;\n: t-quad t-sq t-sq ;\n7\n", true) == rpn::WordDefinition::Result::ok) );
+  r = g_rpn.submit("CLEAR 2 t-quad", 2).get();
+  REQUIRE( (1 == r.outputs.size() && "512" == r.outputs[0]->to_string()) );
+  REQUIRE( (!g_rpn.wordExists("t-gone")) );
+
+  std::filesystem::remove(path);
+  g_rpn.stack.clear();
+}
+
+TEST_CASE( "memory", "interp" ) {
+  g_rpn.stack.clear();
+  auto before = g_rpn.memoryStats();
+
+  // each definition replaces the last, bodies and loops included
+  std::vector<std::string> lines(100, ": t-leak 0 5 FOR i i DROP NEXT ; 3 t-leak");
+  for(auto &f : g_rpn.submit(lines)) {
+    REQUIRE( (f.get().result == rpn::WordDefinition::Result::ok) );
+  }
+  auto defined = g_rpn.memoryStats();
+  REQUIRE( (defined.words == before.words + 1) );
+  REQUIRE( (defined.progns <= before.progns + 4) );
+
+  g_rpn.removeDefinition("t-leak");
+  auto removed = g_rpn.memoryStats();
+  REQUIRE( (removed.words == before.words && removed.progns == before.progns && removed.code == before.code) );
+
+  // a call that fails inside a nested word leaves no frames holding the old bodies
+  g_rpn.parse(": t-sel CASE 1 OF 10 ENDOF 20 ENDCASE ; : t-outer 7 SWAP t-sel ;");
+  for(int i=0; i<3; i++) {
+    g_rpn.parse("1.0 2.0 3.0 ->VEC3 t-outer");
+    g_rpn.stack.clear();
+  }
+  g_rpn.parse(": t-sel 1 ; : t-outer 2 ;");
+  g_rpn.removeDefinition("t-sel");
+  g_rpn.removeDefinition("t-outer");
+  REQUIRE( (g_rpn.memoryStats().progns == before.progns) );
+  g_rpn.stack.clear();
+}
+
+TEST_CASE( "memory limits", "interp" ) {
+  g_rpn.stack.clear();
+  g_rpn.stack.history_limit(1); // no earlier history to trim
+  auto before = g_rpn.memoryStats();
+  REQUIRE( (before.stack == 0) );
+
+  REQUIRE( (g_rpn.submit("1 2 3 3 ->ARRAY .\" abcdefghijklmnopqrstuvwxyz\"").get().result == rpn::WordDefinition::Result::ok) );
+  auto m = g_rpn.memoryStats();
+  REQUIRE( (m.stack > sizeof(StArray) + sizeof(StString) + 3 * sizeof(StInteger) + 26) );
+
+  // an array that won't fit fails, and the request's stack changes with it
+  g_rpn.memoryLimits({ 0, m.total + 64 * 1024 });
+  auto r = g_rpn.submit("DROP 0 10000 FOR i i NEXT 10000 ->ARRAY").get();
+  REQUIRE( (r.result == rpn::WordDefinition::Result::memory_error) );
+  REQUIRE( (2 == g_rpn.stack.depth() && m.stack == g_rpn.memoryStats().stack) );
+  REQUIRE( (g_rpn.memoryStats().peak > m.total + 64 * 1024) );
+  REQUIRE( (!g_rpn.memoryStats().over_soft) );
+  g_rpn.memoryLimits({ m.total / 2, 0 });
+  REQUIRE( (g_rpn.submit("DUP DROP").get().result == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (g_rpn.memoryStats().over_soft) );
+  REQUIRE( (g_rpn.submit("DROP DROP").get().result == rpn::WordDefinition::Result::ok) );
+  g_rpn.memoryLimits({});
+  REQUIRE( (0 == g_rpn.memoryStats().stack) );
+
+  // already over it, words that don't add to the total still run
+  REQUIRE( (g_rpn.submit("0 2000 FOR i i NEXT").get().result == rpn::WordDefinition::Result::ok) );
+  auto full = g_rpn.memoryStats();
+  g_rpn.memoryLimits({ 0, full.total - (full.stack + full.history) / 2 });
+  REQUIRE( (g_rpn.submit("DROP").get().result == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (1999 == g_rpn.stack.depth()) );
+  REQUIRE( (g_rpn.submit("DUP").get().result == rpn::WordDefinition::Result::memory_error) );
+  REQUIRE( (g_rpn.submit("CLEAR").get().result == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (g_rpn.submit("1").get().result == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (1 == g_rpn.stack.depth()) );
+  g_rpn.memoryLimits({});
+  g_rpn.stack.history_limit(4096);
+  g_rpn.stack.clear();
+}
+
+TEST_CASE( "concat", "types" ) {
+  g_rpn.stack.clear();
+  REQUIRE( (g_rpn.submit(".\" G1\" .\" X10\" CONCAT").get().result == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (g_rpn.stack.pop_string() == "G1X10") );
+
+  // appends in place, the accumulator is never copied
+  REQUIRE( (g_rpn.submit(".\" >\" 0 1000 FOR i .\" ab\" + NEXT").get().result == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (1 == g_rpn.stack.depth()) );
+  std::string s = g_rpn.stack.pop_string();
+  REQUIRE( (s.size() == 2001 && s.substr(0,5) == ">abab") );
+  REQUIRE( (0 == g_rpn.memoryStats().stack) );
+
+  // ( obj val key + ) with a string value is still a member add
+  REQUIRE( (g_rpn.submit(".\" v\" .\" a\" ->OBJECT .\" w\" .\" k\" +").get().result == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (1 == g_rpn.stack.depth()) );
+  auto ob = g_rpn.stack.pop();
+  auto &obj = POP_CAST(StObject, ob).inner();
+  REQUIRE( (obj.has_member("a") && obj.has_member("k") && "w" == obj.member("k").to_string()) );
+}
+
+TEST_CASE( "output", "interp" ) {
+  // a small ring, the writer waits on the reader most of the way
+  rpn::OutputChannel ch(256);
+  const int n = 10000;
+  std::thread writer([&ch]{
+    for(int i=0; i<n; i++) {
+      std::string rec = "G1 X" + std::to_string(i);
+      while(!ch.try_write(rec)) {
+	ch.wait_room(rec.size(), std::chrono::milliseconds(10));
+      }
+    }
+  });
+  std::vector<std::string> got;
+  while(got.size() < n) {
+    ch.wait_data(std::chrono::milliseconds(10));
+    ch.drain([&got](const rpn::OutputChannel::Batch &b) {
+      for(auto r : b) {
+	got.emplace_back(r);
+      }
+    });
+  }
+  writer.join();
+  bool inorder = true;
+  for(int i=0; i<n; i++) {
+    inorder = inorder && got[i] == "G1 X" + std::to_string(i);
+  }
+  REQUIRE( inorder );
+  auto st = ch.stats();
+  REQUIRE( (st.records == n && st.batches <= st.records && st.high_water <= ch.capacity()) );
+  REQUIRE( (!ch.try_write(std::string(ch.max_record() + 1, 'x'))) );
+
+  // SEND, drained to a sink
+  g_rpn.stack.clear();
+  auto sink = std::make_shared<rpn::MemorySink>();
+  g_rpn.outputSink(sink);
+  REQUIRE( (g_rpn.submit(".\" G91\" SEND 0 1000 FOR i .\" G1 X1\" SEND NEXT").get().result == rpn::WordDefinition::Result::ok) );
+  REQUIRE( sink->wait_for(1001, std::chrono::seconds(5)) );
+  auto recs = sink->records();
+  REQUIRE( (recs.size() == 1001 && recs[0] == "G91" && recs[1000] == "G1 X1") );
+  g_rpn.outputSink(nullptr);
+  REQUIRE( (0 == g_rpn.stack.depth()) );
+
+  // a record that can't go stays on the stack
+  auto r = g_rpn.submit(".\" x\" 0 16 FOR i DUP + NEXT SEND").get();
+  REQUIRE( (r.result == rpn::WordDefinition::Result::param_error) );
+  REQUIRE( (1 == g_rpn.stack.depth() && 65536 == g_rpn.stack.peek_string(1).size()) );
+  g_rpn.stack.clear();
+
+  // what is sent just before shutdown still reaches the sink
+  auto last = std::make_shared<rpn::MemorySink>();
+  {
+    rpn::Interp rpn;
+    rpn.outputSink(last);
+    rpn.eval("0 5000 FOR i .\" M5\" SEND NEXT");
+    rpn.submit("").get();
+  }
+  REQUIRE( (5000 == last->records().size()) );
+}
+
+TEST_CASE( "save stack", "interp" ) {
+  auto path = (std::filesystem::temp_directory_path() / "rpn-save-test.rpns").string();
+  auto done = [](std::promise<rpn::WordDefinition::Result> &p) {
+    return [&p](rpn::WordDefinition::Result rv) { p.set_value(rv); };
+  };
+  g_rpn.stack.clear();
+  REQUIRE( (g_rpn.submit("1 2").get().result == rpn::WordDefinition::Result::ok) );
+  std::promise<rpn::WordDefinition::Result> saved;
+  g_rpn.saveStack(path, done(saved));
+  REQUIRE( (saved.get_future().get() == rpn::WordDefinition::Result::ok) );
+
+  // a save that fails leaves the last good file alone
+  REQUIRE( (g_rpn.submit(".\" t\" ->TAG 3").get().result == rpn::WordDefinition::Result::ok) );
+  std::promise<rpn::WordDefinition::Result> failed;
+  g_rpn.saveStack(path, done(failed));
+  REQUIRE( (failed.get_future().get() == rpn::WordDefinition::Result::eval_error) );
+  std::promise<rpn::WordDefinition::Result> restored;
+  g_rpn.restoreStack(path, done(restored));
+  REQUIRE( (restored.get_future().get() == rpn::WordDefinition::Result::ok) );
+  REQUIRE( (2 == g_rpn.stack.depth() && 2 == g_rpn.stack.peek_integer(1)) );
+  REQUIRE( (!std::filesystem::exists(path + ".tmp")) );
+  std::filesystem::remove(path);
+  g_rpn.stack.clear();
+}
+
 TEST_CASE( "object", "types" ) {
   std::string line;
   {
@@ -15,6 +15,8 @@
 #include <catch2/catch_test_macros.hpp>
 #include "rpn.h"
 
+#include <sstream>
+
 class CustomArray : public rpn::Stack::Object {
 public:
   CustomArray() = default;
@@ -385,6 +387,148 @@ TEST_CASE("stack operations" "stack") {
 
 }
 
+TEST_CASE("snapshots" "stack") {
+  rpn::Stack st;
+  REQUIRE( st.snapshot()->version == 0 );
+  REQUIRE( st.publish() == 0 ); // nothing changed, nothing published
+
+  st.push_integer(1);
+  st.push_integer(2);
+  st.push_integer(3);
+  auto v1 = st.publish();
+  auto s1 = st.snapshot();
+  REQUIRE( s1->version == v1 );
+  REQUIRE( s1->items.size() == 3 );
+  REQUIRE( (s1->items[0] == "1" && s1->items[2] == "3") );
+  REQUIRE( s1->dirty_from(0) == 0 );
+  REQUIRE( s1->dirty_from(v1) == 3 );
+
+  // only the top two slots change
+  st.swap();
+  auto v2 = st.publish();
+  auto s2 = st.snapshot();
+  REQUIRE( (s2->items[1] == "3" && s2->items[2] == "2") );
+  REQUIRE( s2->dirty_from(v1) == 1 );
+  REQUIRE( s1->items[2] == "3" ); // old snapshot is untouched
+
+  // shrinking doesn't dirty what's left
+  st.drop();
+  st.publish();
+  REQUIRE( st.snapshot()->items.size() == 2 );
+  REQUIRE( st.snapshot()->dirty_from(v2) == 2 );
+
+  size_t notified = 0;
+  st.observe([&notified](const std::shared_ptr<const rpn::Stack::Snapshot> &s) { notified = s->items.size(); });
+  st.clear();
+  st.publish();
+  REQUIRE( notified == 0 );
+  st.push_string("abc");
+  st.publish();
+  REQUIRE( notified == 1 );
+
+  // the status travels with the items, a new status alone is a new version
+  auto v3 = st.publish("+: type error");
+  REQUIRE( v3 == st.snapshot()->version );
+  REQUIRE( (st.snapshot()->status == "+: type error" && st.snapshot()->items.size() == 1) );
+  REQUIRE( st.publish("+: type error") == v3 );
+  REQUIRE( st.publish() == v3+1 );
+  REQUIRE( st.snapshot()->status == "" );
+}
+
+TEST_CASE("binary encoding" "stack") {
+  rpn::Stack st;
+  st.push_double(1.0/3.0);
+  st.push_integer(-1234567890123LL);
+  st.push_boolean(true);
+  st.push_string(std::string("a\0b", 3));
+  st.push(StVec3(1.5, -2.25));
+  StArray arr;
+  arr.inner().add_value(StInteger(7));
+  arr.inner().add_value(StString(std::string("seven")));
+  StObject obj;
+  obj.inner().add_value("list", arr);
+  obj.inner().add_value("pi", StDouble(M_PI));
+  st.push(arr);
+  st.push(obj);
+
+  std::stringstream ss;
+  st.save(ss);
+  rpn::Stack back;
+  back.push_integer(99);
+  back.load(ss);
+  REQUIRE( back.depth() == st.depth() );
+  for(int i=1; i<=(int)st.depth(); i++) {
+    REQUIRE( back.type(i) == st.type(i) );
+    REQUIRE( back.peek(i) == st.peek(i) );
+  }
+  REQUIRE( back.peek_double(7) == 1.0/3.0 ); // exact, not as printed
+
+  // bad streams throw and leave the stack alone
+  std::string bytes = ss.str();
+  std::stringstream cut(bytes.substr(0, bytes.size()-5));
+  REQUIRE_THROWS( back.load(cut) );
+  std::stringstream junk("not a stack");
+  REQUIRE_THROWS( back.load(junk) );
+  REQUIRE( back.depth() == st.depth() );
+
+  // application types have no encoding
+  st.push(CustomArray());
+  std::stringstream ss2;
+  REQUIRE_THROWS( st.save(ss2) );
+  rpn::Stack partial;
+  REQUIRE_THROWS( partial.load(ss2) ); // no end tag, it isn't taken for a shorter stack
+  REQUIRE( partial.depth() == 0 );
+}
+
+TEST_CASE("footprint" "stack") {
+  rpn::Stack st;
+  REQUIRE( st.bytes() == 0 );
+  StArray arr;
+  for(int i=0; i<100; i++) {
+    arr.inner().add_value(StInteger(i));
+  }
+  st.push(arr);
+  REQUIRE( st.bytes() == arr.footprint() );
+  REQUIRE( st.bytes() > 100 * sizeof(StInteger) );
+  st.dup();
+  st.push_string(std::string(1000, 'x'));
+  REQUIRE( st.bytes() > 2 * arr.footprint() + 1000 );
+  st.checkpoint();
+  size_t kept = st.bytes();
+  REQUIRE( st.history_bytes() == kept );
+
+  // changes since the checkpoint are dropped, the counts follow
+  st.drop();
+  st.swap();
+  st.push_double(1.0);
+  st.rollback();
+  REQUIRE( st.depth() == 3 );
+  REQUIRE( st.peek_string(1).size() == 1000 );
+  REQUIRE( st.bytes() == kept );
+  st.dropn(3);
+  REQUIRE( st.bytes() == 0 );
+}
+
+TEST_CASE("history limit" "stack") {
+  rpn::Stack st;
+  st.history_limit(2);
+  for(int i=0; i<1000; i++) {
+    st.push_integer(i);
+  }
+  st.checkpoint();
+  // each fold hands the deep stack to the next state
+  for(int i=0; i<5; i++) {
+    st.push_integer(i);
+    st.checkpoint();
+  }
+  REQUIRE( st.undo_levels() == 1 );
+  REQUIRE( st.undo() );
+  REQUIRE( st.depth() == 1004 );
+  REQUIRE( st.peek_integer(1) == 3 );
+  REQUIRE( st.peek_integer(1004) == 0 );
+  REQUIRE( !st.undo() );
+}
+
 // TEST_CASE("object-test StDouble", "[single-file]") {}
 // TEST_CASE("object-test StInteger", "[single-file]") {}
 // TEST_CASE("object-test StString", "[single-file]") {}
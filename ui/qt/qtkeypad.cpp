@@ -9,6 +9,9 @@
 #include <QMenu>
 #include <QMenuBar>
 #include <QFileDialog>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
 
 struct QtKeypadController::Privates {
   Privates(rpn::Interp &rpn, QtKeypadController *d) : _rpn(rpn), _rpnd(d), _ui(new Ui::RpnKeypad) {
@@ -31,6 +34,17 @@ struct QtKeypadController::Privates {
     _mFile->addAction(action);
     connect(action, &QAction::triggered, _rpnd, &QtKeypadController::on_file_restore_stack);
 
+    _mEdit = menubar->addMenu("&Edit");
+    action = new QAction("Undo", _rpnd);
+    action->setShortcut(QKeySequence::Undo);
+    _mEdit->addAction(action);
+    connect(action, &QAction::triggered, _rpnd, &QtKeypadController::on_edit_undo);
+
+    action = new QAction("Redo", _rpnd);
+    action->setShortcut(QKeySequence::Redo);
+    _mEdit->addAction(action);
+    connect(action, &QAction::triggered, _rpnd, &QtKeypadController::on_edit_redo);
+
     connect(_rpnd, &QtKeypadController::signal_rpn_complete, _rpnd, &QtKeypadController::on_rpn_completed);
 
     _mKeys = menubar->addMenu("&Keys");
@@ -108,8 +122,10 @@ struct QtKeypadController::Privates {
   Ui::RpnKeypad* _ui;
   QMenu *_mKeys;
   QMenu *_mFile;
+  QMenu *_mEdit;
+  std::shared_ptr<const rpn::Stack::Snapshot> _shown; // what the display currently shows
 
-  void redraw_display() const;
+  void redraw_display();
   void assign_button(unsigned column, unsigned row, const std::string &rpnword, const QString &label="");
   void assign_menu(const QString &menu, const std::string &rpnword, const QString &label="");
 
@@ -171,16 +187,40 @@ QtKeypadController::on_file_open() {
 						  "Open RPN Script", "", "RPN Files (*.rpn *.4th *.4nc)");
   if (fileName != "") {
     _p->_rpn.parseFile(fileName.toStdString(), [this](rpn::WordDefinition::Result rv) {
-	_p->redraw_display();
+	emit signal_rpn_complete();
       });
   }
 }
 
 void
 QtKeypadController::on_file_save_stack() {
+  QString fileName = QFileDialog::getSaveFileName(this,
+						  "Save Stack", "", "RPN Stack (*.rpns)");
+  if (fileName != "") {
+    _p->_rpn.saveStack(fileName.toStdString(), [this](rpn::WordDefinition::Result rv) {
+	emit signal_rpn_complete();
+      });
+  }
 }
 void
 QtKeypadController::on_file_restore_stack() {
+  QString fileName = QFileDialog::getOpenFileName(this,
+						  "Restore Stack", "", "RPN Stack (*.rpns)");
+  if (fileName != "") {
+    _p->_rpn.restoreStack(fileName.toStdString(), [this](rpn::WordDefinition::Result rv) {
+	emit signal_rpn_complete();
+      });
+  }
+}
+
+void
+QtKeypadController::on_edit_undo() {
+  _p->rpn_eval("UNDO");
+}
+
+void
+QtKeypadController::on_edit_redo() {
+  _p->rpn_eval("REDO");
 }
 
 /******************************** DIGITS ********************************/
@@ -310,16 +350,36 @@ void QtKeypadController::on_programmable_button_clicked() {
 /******************************** Stack display  ********************************/
 
 void
-QtKeypadController::Privates::redraw_display() const {
-  _ui->textEdit->clear();
-  _ui->textEdit->setAlignment(Qt::AlignRight);
-  
-  for(size_t i=_rpn.stack.depth(); i!=0; i--) {
-    char level[32];
-    snprintf(level, sizeof(level), " : %02d%s", i, i>1?"\n":"");
-    auto so = _rpn.stack.peek_as_string(i);
-    _ui->textEdit->insertPlainText(QString::fromStdString(so+level));
+QtKeypadController::Privates::redraw_display() {
+  // the stack belongs to the interpreter thread, only look at published snapshots
+  auto snap = _rpn.stack.snapshot();
+  size_t depth = snap->items.size();
+
+  if (_shown && _shown->items.size() == depth) {
+    // same depth means the level labels are unchanged, just replace the dirty lines
+    QTextDocument *doc = _ui->textEdit->document();
+    for(size_t i=snap->dirty_from(_shown->version); i<depth; i++) {
+      char level[32];
+      snprintf(level, sizeof(level), " : %02d", int(depth-i));
+      QTextCursor cursor(doc->findBlockByNumber(int(i)));
+      cursor.movePosition(QTextCursor::StartOfBlock);
+      cursor.movePosition(QTextCursor::EndOfBlock, QTextCursor::KeepAnchor);
+      cursor.insertText(QString::fromStdString(snap->items[i]+level));
+    }
+
+  } else {
+    _ui->textEdit->clear();
+    _ui->textEdit->setAlignment(Qt::AlignRight);
+
+    for(size_t i=depth; i!=0; i--) {
+      char level[32];
+      snprintf(level, sizeof(level), " : %02d%s", int(i), i>1?"\n":"");
+      auto &so = snap->items[depth-i];
+      _ui->textEdit->insertPlainText(QString::fromStdString(so+level));
+    }
   }
-  _ui->statusLabel->setText(QString::fromStdString(_rpn.status()));
+  _shown = snap;
+
+  _ui->statusLabel->setText(QString::fromStdString(snap->status));
   _ui->textEdit->verticalScrollBar()->setValue(_ui->textEdit->verticalScrollBar()->maximum());
 }
@@ -54,6 +54,8 @@ public:
     void on_file_open();
     void on_file_save_stack();
     void on_file_restore_stack();
+    void on_edit_undo();
+    void on_edit_redo();
 
     void on_rpn_completed();
 